@@ -2,57 +2,94 @@
 #include "DDImage/Iop.h"
 #include "DDImage/Row.h"
 #include "DDImage/Knobs.h"
+#include "SimpleColorKeyerCore.h"
+#include "SimpleColorKeyerCache.h"
+#include "SimpleColorKeyerArena.h"
+#include "SimpleColorKeyerPrefilter.h"
+#include "SimpleColorKeyerLocalStats.h"
+#include "SimpleColorKeyerKeyGrid.h"
+#include "SimpleColorKeyerIdMatte.h"
+#include "SimpleColorKeyerProbes.h"
 #include <cmath>
 #include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace DD::Image;
 
-struct Color3 {
-    float r, g, b;
-    Color3() : r(0), g(0), b(0) {}
-    Color3(float r_, float g_, float b_) : r(r_), g(g_), b(b_) {}
-    float distance_to(const Color3& other) const {
-        float dr = r - other.r;
-        float dg = g - other.g;
-        float db = b - other.b;
-        return sqrt(dr*dr + dg*dg + db*db);
-    }
-};
-
 class SimpleColorKeyerIop : public Iop {
 private:
-    float key_color_[3];        // RGB color to key
-    float variance_;            // Color variance/tolerance
-    float range_red_;           // Red direction (-3 to +3)
-    float range_magenta_;       // Magenta direction (-3 to +3)
-    float range_green_;         // Green direction (-3 to +3)
-    float range_yellow_;        // Yellow direction (-3 to +3)
-    float range_blue_;          // Blue direction (-3 to +3)
-    float range_cyan_;          // Cyan direction (-3 to +3)
-    float gain_;               // Alpha gain/contrast
-    bool invert_;              // Invert the matte
-    int keying_method_;        // 0=distance, 1=chroma, 2=luma weighted, 3=adaptive
+    KeyerParams params_;        // Knob values (defaults: green screen, 30% tolerance)
+    bool cache_mattes_;         // Keep computed mattes in matte_cache_
+    int cache_size_mb_;         // Memory cap for matte_cache_
+    
+    MatteCache matte_cache_;    // Compressed alpha per frame and knob hash
+    uint64_t cache_key_;        // Key of the frame being rendered
+    
+    bool prefilter_;            // Key from chroma smoothed by grid_
+    int prefilter_size_;        // Grid cell in pixels
+    float prefilter_range_;     // Grid range slice, in chroma distance
+    std::unique_ptr<ChromaGrid> grid_;  // Built lazily by engine() per frame and knob hash
+    uint64_t grid_hash_;
+    
+    bool adaptive_tolerance_;   // Scale the tolerance by the local noise in stats_
+    int noise_window_;          // Radius of the noise window in pixels
+    float noise_reference_;     // Noise level at which the tolerance applies as set
+    std::unique_ptr<LocalStats> stats_;     // Built by the first engine() per frame and knob hash
+    uint64_t stats_hash_;
+    
+    bool local_screen_;         // Key against the local screen color in screen_
+    int screen_window_;         // Radius of the screen window in pixels
+    std::unique_ptr<ScreenEstimate> screen_;    // Built like stats_
+    uint64_t screen_hash_;
+    
+    std::unique_ptr<TaskPool> pool_;        // Builds stats_ and screen_
+    
+    const char* key_grid_text_;  // Key colors, "r g b" per sample, top row first
+    int key_grid_columns_;      // Samples per grid row
+    KeyGrid key_grid_;          // Parsed from key_grid_text_; empty when off
+    
+    enum IdMode { ID_OFF, ID_INDEX_COVERAGE, ID_CHANNELS };
+    static constexpr int kMaxIdChannels = 64;  // Palette limit in ID_CHANNELS mode
+    
+    int id_mode_;               // IdMode
+    const char* id_palette_text_;   // ID colors, "r g b" per color
+    float id_tolerance_;        // Distance at which an ID matte falls to 0
+    IdPalette id_palette_;      // Parsed from id_palette_text_; empty when off
+    Channel id_index_;          // id.index and id.coverage, in ID_INDEX_COVERAGE mode
+    Channel id_coverage_;
+    std::vector<Channel> id_mattes_;    // One per color, in ID_CHANNELS mode
+    ChannelSet id_channels_;    // All of the above
     
 public:
     SimpleColorKeyerIop(Node* node) : Iop(node) {
-        // Default green screen color
-        key_color_[0] = 0.0f;  // Red
-        key_color_[1] = 1.0f;  // Green  
-        key_color_[2] = 0.0f;  // Blue
-        
-        variance_ = 0.3f;      // 30% tolerance
-        range_red_ = 0.0f;     // No red expansion
-        range_magenta_ = 0.0f; // No magenta expansion
-        range_green_ = 0.0f;   // No green expansion
-        range_yellow_ = 0.0f;  // No yellow expansion
-        range_blue_ = 0.0f;    // No blue expansion
-        range_cyan_ = 0.0f;    // No cyan expansion
-        gain_ = 1.0f;          // No gain adjustment
-        invert_ = false;       // Normal matte
-        keying_method_ = 0;    // Distance-based keying
+        cache_mattes_ = false;  // Off by default: rely on Nuke's own cache
+        cache_size_mb_ = 256;
+        cache_key_ = 0;
+        prefilter_ = false;
+        prefilter_size_ = 16;
+        prefilter_range_ = 0.1f;
+        grid_hash_ = 0;
+        adaptive_tolerance_ = false;
+        noise_window_ = 8;
+        noise_reference_ = 0.02f;
+        stats_hash_ = 0;
+        local_screen_ = false;
+        screen_window_ = 64;
+        screen_hash_ = 0;
+        key_grid_text_ = nullptr;
+        key_grid_columns_ = 4;
+        id_mode_ = ID_OFF;
+        id_palette_text_ = nullptr;
+        id_tolerance_ = 0.05f;
+        id_index_ = id_coverage_ = Chan_Black;
     }
     
     void _validate(bool for_real) override {
+        SCK_PROBE2(validate_entry, for_real, params_.keying_method);
         Iop::_validate(for_real);
         copy_info();
         
@@ -64,9 +101,72 @@ public:
         if (info_.channels() & Mask_RGB) {
             info_.turn_on(Mask_Alpha);
         }
+        
+        if (cache_mattes_) {
+            matte_cache_.set_capacity((size_t)std::max(1, cache_size_mb_) << 20);
+            cache_key_ = matte_cache_key(hash().value(), outputContext().frame());
+        } else {
+            matte_cache_.clear();
+        }
+        
+        key_grid_ = KeyGrid();
+        if (key_grid_text_ && *key_grid_text_) {
+            const std::string message = key_grid_.parse(key_grid_text_, key_grid_columns_);
+            if (!message.empty()) {
+                error("%s", message.c_str());
+                SCK_PROBE2(validate_exit, for_real, params_.keying_method);
+                return;
+            }
+            key_grid_.set_frame(info_.x(), info_.y(), info_.w(), info_.h());
+        }
+        
+        if (!validate_id_mattes()) {
+            SCK_PROBE2(validate_exit, for_real, params_.keying_method);
+            return;
+        }
+        
+        // A new frame or new knobs: start a new grid for engine() to fill in
+        if (!prefilter_ || info_.w() <= 0 || info_.h() <= 0) {
+            grid_.reset();
+        } else if (!grid_ || grid_hash_ != hash().value()) {
+            grid_.reset(new ChromaGrid(info_.x(), info_.y(), info_.w(), info_.h(), prefilter_cell(),
+                                       prefilter_range_, params_.key(), input_rows()));
+            grid_hash_ = hash().value();
+        }
+        
+        // Likewise for the noise statistics
+        if (!adaptive_tolerance_ || info_.w() <= 0 || info_.h() <= 0) {
+            stats_.reset();
+        } else if (!stats_ || stats_hash_ != hash().value()) {
+            stats_.reset(new LocalStats(info_.x(), info_.y(), info_.w(), info_.h(), input_rows()));
+            stats_hash_ = hash().value();
+        }
+        
+        // And for the local screen estimate
+        if (!local_screen_ || info_.w() <= 0 || info_.h() <= 0) {
+            screen_.reset();
+        } else if (!screen_ || screen_hash_ != hash().value()) {
+            screen_.reset(new ScreenEstimate(info_.x(), info_.y(), info_.w(), info_.h(), params_, input_rows()));
+            screen_hash_ = hash().value();
+        }
+        if ((stats_ || screen_) && !pool_) {
+            pool_.reset(new TaskPool((int)std::max(1u, std::thread::hardware_concurrency())));
+        }
+        SCK_PROBE2(validate_exit, for_real, params_.keying_method);
+    }
+    
+    // Drop the per-frame tables, which run to hundreds of MB at UHD, when
+    // Nuke closes the node
+    void _close() override {
+        grid_.reset();
+        stats_.reset();
+        screen_.reset();
+        grid_hash_ = stats_hash_ = screen_hash_ = 0;
+        Iop::_close();
     }
     
     void _request(int x, int y, int r, int t, ChannelMask channels, int count) override {
+        SCK_PROBE6(request_entry, x, y, r, t, channels.value(), count);
         // Always request RGB from input
         ChannelMask input_channels = Mask_RGB;
         
@@ -75,178 +175,269 @@ public:
             // We generate alpha from RGB, so just request RGB
         }
         
+        // Cached mattes are keyed a full row at a time
+        if (cache_mattes_) {
+            x = std::min(x, info_.x());
+            r = std::max(r, info_.r());
+        }
+        
+        // The prefilter splats full-width rows up to three grid cells away
+        if (prefilter_) {
+            x = std::min(x, info_.x());
+            r = std::max(r, info_.r());
+            y -= ChromaGrid::padding(prefilter_cell());
+            t += ChromaGrid::padding(prefilter_cell());
+        }
+        
+        // The noise statistics and screen estimate are summed over the whole frame
+        if (adaptive_tolerance_ || local_screen_) {
+            x = std::min(x, info_.x());
+            y = std::min(y, info_.y());
+            r = std::max(r, info_.r());
+            t = std::max(t, info_.t());
+        }
+        
         input0().request(x, y, r, t, input_channels, count);
+        SCK_PROBE6(request_exit, x, y, r, t, channels.value(), count);
     }
     
     void engine(int y, int x, int r, ChannelMask channels, Row& row) override {
-        Row input_row(x, r);
-        input0().get(y, x, r, Mask_RGB, input_row);
+        SCK_PROBE5(engine_entry, y, x, r, channels.value(), params_.keying_method);
+        ScratchArena::Scope scratch;
+        if (cache_mattes_ && engine_cached(y, x, r, channels, row)) {
+            SCK_PROBE6(engine_exit, y, x, r, channels.value(), params_.keying_method, 1);
+            return;
+        }
         
-        Color3 key_color(key_color_[0], key_color_[1], key_color_[2]);
+        // RGB passes through, so fetch it straight into the output row: no
+        // separate input Row to allocate and copy out of
+        input0().get(y, x, r, Mask_RGB, row);
         
-        for (int X = x; X < r; X++) {
-            Color3 pixel_color(
-                input_row[Chan_Red][X], 
-                input_row[Chan_Green][X], 
-                input_row[Chan_Blue][X]
-            );
-            
-            float alpha = calculate_alpha(pixel_color, key_color);
-            
-            // Apply gain
-            alpha = alpha * gain_;
-            alpha = std::max(0.0f, std::min(1.0f, alpha));
-            
-            if (invert_) {
-                alpha = 1.0f - alpha;
-            }
-            
-            // Output channels - always pass through RGB, alpha goes to alpha channel
-            if (channels & Mask_Red)   row.writable(Chan_Red)[X] = input_row[Chan_Red][X];
-            if (channels & Mask_Green) row.writable(Chan_Green)[X] = input_row[Chan_Green][X];
-            if (channels & Mask_Blue)  row.writable(Chan_Blue)[X] = input_row[Chan_Blue][X];
-            
-            // ALWAYS output alpha (not conditional)
-            row.writable(Chan_Alpha)[X] = alpha;
-        }
+        // Keying method, gain, clamp and invert (SimpleColorKeyerCore.h)
+        key_input(y, x, r, row[Chan_Red] + x, row[Chan_Green] + x, row[Chan_Blue] + x,
+                  row.writable(Chan_Alpha) + x);
+        id_matte_row(x, r, channels, row[Chan_Red] + x, row[Chan_Green] + x, row[Chan_Blue] + x, row);
+        SCK_PROBE6(engine_exit, y, x, r, channels.value(), params_.keying_method, 0);
     }
     
 private:
-    // Intelligent alpha calculation based on keying method
-    float calculate_alpha(const Color3& pixel, const Color3& key) {
-        float alpha = 0.0f;
-        
-        switch (keying_method_) {
-            case 0: // Distance-based (default)
-                alpha = calculate_distance_alpha(pixel, key);
-                break;
-            case 1: // Chroma-based (ignore luminance)
-                alpha = calculate_chroma_alpha(pixel, key);
-                break;
-            case 2: // Luma-weighted
-                alpha = calculate_luma_weighted_alpha(pixel, key);
-                break;
-            case 3: // Adaptive (combines multiple methods)
-                alpha = calculate_adaptive_alpha(pixel, key);
-                break;
-        }
-        
-        return alpha;
-    }
+    int prefilter_cell() const { return std::max(8, prefilter_size_); }
     
-    float calculate_distance_alpha(const Color3& pixel, const Color3& key) {
-        // Calculate how much this pixel matches each of the 6 color directions
-        float red_match = pixel.r;                           // Pure red component
-        float green_match = pixel.g;                         // Pure green component  
-        float blue_match = pixel.b;                          // Pure blue component
-        float yellow_match = std::min(pixel.r, pixel.g);     // Yellow = min(R,G)
-        float magenta_match = std::min(pixel.r, pixel.b);    // Magenta = min(R,B)
-        float cyan_match = std::min(pixel.g, pixel.b);       // Cyan = min(G,B)
-        
-        // Calculate base distance
-        float base_distance = pixel.distance_to(key);
-        
-        // Start with base tolerance
-        float effective_tolerance = variance_;
-        
-        // Add tolerance expansion based on how much the pixel matches each color direction
-        if (range_red_ > 0.0f) {
-            effective_tolerance += range_red_ * 0.1f * red_match;
+    // Parse the ID palette and turn on its output channels. Returns false
+    // after reporting an error.
+    bool validate_id_mattes() {
+        id_palette_ = IdPalette();
+        id_mattes_.clear();
+        id_index_ = id_coverage_ = Chan_Black;
+        id_channels_ = ChannelSet();
+        if (id_mode_ == ID_OFF || !id_palette_text_ || !*id_palette_text_) {
+            return true;
         }
-        if (range_green_ > 0.0f) {
-            effective_tolerance += range_green_ * 0.1f * green_match;
+        const std::string message = id_palette_.parse(id_palette_text_, id_tolerance_);
+        if (!message.empty()) {
+            error("%s", message.c_str());
+            return false;
         }
-        if (range_blue_ > 0.0f) {
-            effective_tolerance += range_blue_ * 0.1f * blue_match;
+        if (id_mode_ == ID_CHANNELS) {
+            if (id_palette_.size() > kMaxIdChannels) {
+                error("ID channels hold at most %d colors; use Index + Coverage for more", kMaxIdChannels);
+                return false;
+            }
+            // Four colors per layer, idmatte0.red to idmatte0.alpha for
+            // colors 0 to 3 and so on
+            static const char* const components[] = { "red", "green", "blue", "alpha" };
+            for (int k = 0; k < id_palette_.size(); k++) {
+                const std::string name = "idmatte" + std::to_string(k / 4) + "." + components[k % 4];
+                id_mattes_.push_back(getChannel(name.c_str()));
+                id_channels_ += id_mattes_.back();
+            }
+        } else {
+            id_index_ = getChannel("id.index");
+            id_coverage_ = getChannel("id.coverage");
+            id_channels_ += id_index_;
+            id_channels_ += id_coverage_;
         }
-        if (range_yellow_ > 0.0f) {
-            effective_tolerance += range_yellow_ * 0.1f * yellow_match;
+        ChannelSet out = Mask_RGBA;
+        out += id_channels_;
+        set_out_channels(out);
+        info_.turn_on(id_channels_);
+        return true;
+    }
+    
+    // ID mattes of pixels [x, r) of the row, from the input RGB (indexed from
+    // x), into whichever ID channels are requested: one nearest-color search
+    // per pixel whatever the palette size
+    void id_matte_row(int x, int r, ChannelMask channels, const float* red, const float* green,
+                      const float* blue, Row& row) {
+        if (id_palette_.size() == 0 || !(channels & id_channels_)) {
+            return;
         }
-        if (range_magenta_ > 0.0f) {
-            effective_tolerance += range_magenta_ * 0.1f * magenta_match;
+        ScratchArena& arena = ScratchArena::local();
+        int* index = arena.alloc<int>(r - x);
+        float* coverage = arena.alloc<float>(r - x);
+        id_palette_.match_row(red, green, blue, r - x, index, coverage);
+        
+        if (id_mode_ == ID_INDEX_COVERAGE) {
+            // Index counts from 1, so 0 means no color matched
+            if (channels.contains(id_index_)) {
+                float* out = row.writable(id_index_) + x;
+                for (int i = 0; i < r - x; i++) out[i] = (float)(index[i] + 1);
+            }
+            if (channels.contains(id_coverage_)) {
+                memcpy(row.writable(id_coverage_) + x, coverage, (r - x) * sizeof(float));
+            }
+            return;
         }
-        if (range_cyan_ > 0.0f) {
-            effective_tolerance += range_cyan_ * 0.1f * cyan_match;
+        for (int k = 0; k < (int)id_mattes_.size(); k++) {
+            if (!channels.contains(id_mattes_[k])) continue;
+            float* out = row.writable(id_mattes_[k]) + x;
+            for (int i = 0; i < r - x; i++) out[i] = index[i] == k ? coverage[i] : 0.0f;
         }
+    }
+    
+    // Full-width input rows for the prefilter grid and the noise statistics
+    std::function<void(int, float*, float*, float*)> input_rows() {
+        const int x0 = info_.x(), x1 = info_.r();
+        Iop* input = &input0();
+        return [input, x0, x1](int y, float* r, float* g, float* b) {
+            Row in(x0, x1);
+            input->get(y, x0, x1, Mask_RGB, in);
+            memcpy(r, in[Chan_Red] + x0, (x1 - x0) * sizeof(float));
+            memcpy(g, in[Chan_Green] + x0, (x1 - x0) * sizeof(float));
+            memcpy(b, in[Chan_Blue] + x0, (x1 - x0) * sizeof(float));
+        };
+    }
+    
+    // Alpha of input pixels [x, r) of row y. With the prefilter on they are
+    // keyed from a chroma-smoothed copy; the RGB output is not filtered. With
+    // the adaptive tolerance on, each pixel's tolerance follows the noise of
+    // the unfiltered input around it, and with the local screen on, each
+    // pixel is keyed against the screen color around it. Otherwise a key
+    // grid, if set, gives the key color.
+    void key_input(int y, int x, int r, const float* red, const float* green, const float* blue,
+                   float* alpha) {
+        // The first call per frame builds the tables, fetching the whole input
+        if (screen_) screen_->build(*pool_);
+        if (stats_) stats_->build(*pool_);
         
-        // Handle negative values (contract tolerance for those colors)
-        if (range_red_ < 0.0f) {
-            effective_tolerance += range_red_ * 0.1f * red_match; // This will subtract
-        }
-        if (range_green_ < 0.0f) {
-            effective_tolerance += range_green_ * 0.1f * green_match;
+        ScratchArena& arena = ScratchArena::local();
+        Color3* column_keys = key_grid_.empty() ? nullptr : arena.alloc<Color3>(key_grid_.columns());
+        float* keys = nullptr;
+        if (screen_) {
+            keys = arena.alloc<float>((size_t)(r - x) * 3);
+            screen_->local_key_row(y, x, r, std::max(1, screen_window_), keys, keys + (r - x),
+                                   keys + 2 * (r - x));
         }
-        if (range_blue_ < 0.0f) {
-            effective_tolerance += range_blue_ * 0.1f * blue_match;
+        float* tolerance = nullptr;
+        if (stats_) {
+            tolerance = arena.alloc<float>(r - x);
+            stats_->sigma_row(y, x, r, std::max(1, noise_window_), tolerance);
+            for (int i = 0; i < r - x; i++) {
+                tolerance[i] = noise_scaled_tolerance(params_.variance, tolerance[i], noise_reference_);
+            }
         }
-        if (range_yellow_ < 0.0f) {
-            effective_tolerance += range_yellow_ * 0.1f * yellow_match;
+        if (column_keys && !keys && tolerance) {
+            // Combined with the adaptive tolerance: spell the grid's key colors out
+            keys = arena.alloc<float>((size_t)(r - x) * 3);
+            key_grid_.column_keys(y, column_keys);
+            key_grid_.walk_row(column_keys, x, r, [&](int i, const Color3& key) {
+                keys[i] = key.r;
+                keys[(r - x) + i] = key.g;
+                keys[2 * (r - x) + i] = key.b;
+            });
         }
-        if (range_magenta_ < 0.0f) {
-            effective_tolerance += range_magenta_ * 0.1f * magenta_match;
+        if (grid_) {
+            float* filtered = arena.alloc<float>((size_t)(r - x) * 3);
+            grid_->filter_row(y, x, r, red, green, blue, filtered, filtered + (r - x),
+                              filtered + 2 * (r - x));
+            red = filtered;
+            green = filtered + (r - x);
+            blue = filtered + 2 * (r - x);
         }
-        if (range_cyan_ < 0.0f) {
-            effective_tolerance += range_cyan_ * 0.1f * cyan_match;
+        if (keys || tolerance) {
+            key_row_local(params_, red, green, blue, keys, keys ? keys + (r - x) : nullptr,
+                          keys ? keys + 2 * (r - x) : nullptr, tolerance, alpha, r - x);
+        } else if (column_keys) {
+            key_row_grid(params_, key_grid_, y, x, r, red, green, blue, alpha, column_keys);
+        } else {
+            key_row(params_, red, green, blue, alpha, r - x);
         }
-        
-        // Ensure minimum tolerance
-        effective_tolerance = std::max(0.001f, effective_tolerance);
-        
-        // Calculate final alpha
-        float normalized_distance = base_distance / effective_tolerance;
-        return std::max(0.0f, 1.0f - normalized_distance);
     }
     
-    float calculate_chroma_alpha(const Color3& pixel, const Color3& key) {
-        // Convert to YUV-like space to ignore luminance
-        float pixel_u = pixel.r - pixel.g;
-        float pixel_v = pixel.b - pixel.g;
-        float key_u = key.r - key.g;
-        float key_v = key.b - key.g;
-        
-        float chroma_distance = sqrtf((pixel_u - key_u) * (pixel_u - key_u) + 
-                                     (pixel_v - key_v) * (pixel_v - key_v));
-        float normalized_distance = chroma_distance / variance_;
-        return std::max(0.0f, 1.0f - normalized_distance);
-    }
-    
-    float calculate_luma_weighted_alpha(const Color3& pixel, const Color3& key) {
-        float pixel_luma = 0.299f * pixel.r + 0.587f * pixel.g + 0.114f * pixel.b;
-        float key_luma = 0.299f * key.r + 0.587f * key.g + 0.114f * key.b;
+    // Serve a row from the matte cache. On a miss the whole row is keyed and
+    // stored, so later requests for any part of it hit. Returns false if the
+    // row lies outside the cached area (the caller keys it directly).
+    bool engine_cached(int y, int x, int r, ChannelMask channels, Row& row) {
+        const int cx = info_.x();
+        const int cr = info_.r();
+        if (y < info_.y() || y >= info_.t() || x < cx || r > cr) {
+            return false;
+        }
         
-        float luma_diff = std::abs(pixel_luma - key_luma);
-        float luma_weight = 1.0f - std::min(1.0f, luma_diff / 0.5f);
+        float* alpha = ScratchArena::local().alloc<float>(cr - cx);
+        bool hit = matte_cache_.get_row(cache_key_, y, cx, cr - cx, alpha);
         
-        float color_alpha = calculate_distance_alpha(pixel, key);
-        return color_alpha * luma_weight;
-    }
-    
-    float calculate_adaptive_alpha(const Color3& pixel, const Color3& key) {
-        float distance_alpha = calculate_distance_alpha(pixel, key);
-        float chroma_alpha = calculate_chroma_alpha(pixel, key);
+        // RGB passes through, so the input is still needed when RGB is requested
+        if (hit && (channels & Mask_RGB)) {
+            input0().get(y, x, r, Mask_RGB, row);
+        } else if (!hit && x == cx && r == cr) {
+            // A full-width miss: fetch into the output row and key from there
+            input0().get(y, x, r, Mask_RGB, row);
+            key_input(y, cx, cr, row[Chan_Red] + cx, row[Chan_Green] + cx, row[Chan_Blue] + cx,
+                      alpha);
+            matte_cache_.put_row(cache_key_, info_.y(), info_.t() - info_.y(), cx, cr - cx,
+                                 y, alpha);
+        } else if (!hit) {
+            // A partial miss still keys the whole row, which the output row
+            // cannot hold. This Row is the one heap allocation left in
+            // engine(); it happens once per row and frame, when the row is
+            // first cached.
+            Row input_row(cx, cr);
+            input0().get(y, cx, cr, Mask_RGB, input_row);
+            key_input(y, cx, cr, input_row[Chan_Red] + cx, input_row[Chan_Green] + cx,
+                      input_row[Chan_Blue] + cx, alpha);
+            matte_cache_.put_row(cache_key_, info_.y(), info_.t() - info_.y(), cx, cr - cx,
+                                 y, alpha);
+            
+            // All of RGB, requested or not: ID mattes read it from the row
+            memcpy(row.writable(Chan_Red) + x, input_row[Chan_Red] + x, (r - x) * sizeof(float));
+            memcpy(row.writable(Chan_Green) + x, input_row[Chan_Green] + x, (r - x) * sizeof(float));
+            memcpy(row.writable(Chan_Blue) + x, input_row[Chan_Blue] + x, (r - x) * sizeof(float));
+        }
         
-        // Weight based on how saturated the key color is
-        float key_saturation = std::max({key.r, key.g, key.b}) - std::min({key.r, key.g, key.b});
+        memcpy(row.writable(Chan_Alpha) + x, alpha + (x - cx), (r - x) * sizeof(float));
         
-        if (key_saturation > 0.5f) {
-            // Highly saturated key color - prefer chroma keying
-            return 0.3f * distance_alpha + 0.7f * chroma_alpha;
-        } else {
-            // Less saturated key color - prefer distance keying
-            return 0.7f * distance_alpha + 0.3f * chroma_alpha;
+        if (id_palette_.size() > 0 && (channels & id_channels_)) {
+            // Only an alpha-only hit skipped the input; fetch RGB into the
+            // output row as engine() does
+            if (hit && !(channels & Mask_RGB)) {
+                input0().get(y, x, r, Mask_RGB, row);
+            }
+            id_matte_row(x, r, channels, row[Chan_Red] + x, row[Chan_Green] + x, row[Chan_Blue] + x, row);
         }
+        return true;
     }
     
 public:
     void knobs(Knob_Callback f) override {
         Divider(f, "Simple Color Keyer");
         
-        Color_knob(f, key_color_, IRange(0, 1), "key_color", "Key Color");
+        Color_knob(f, params_.key_color, IRange(0, 1), "key_color", "Key Color");
         Tooltip(f, "The base color to key out. Use the color picker to select.");
         
-        Float_knob(f, &variance_, IRange(0.001f, 2.0f), "variance", "Tolerance");
+        Float_knob(f, &params_.variance, IRange(0.001f, 2.0f), "variance", "Tolerance");
         Tooltip(f, "Overall color matching tolerance. Lower values = more precise keying.");
         
+        Multiline_String_knob(f, &key_grid_text_, "key_grid", "Key Grid", 4);
+        Tooltip(f, "Optional grid of key colors across the frame, for uneven screens: "
+                   "\"r g b\" per sample, the top row first, Key Grid Columns samples per "
+                   "row, 2 to 16 rows. The corner samples sit on the frame's corner pixels "
+                   "and each pixel is keyed against the bilinear blend of the four around "
+                   "it. Leave empty to use Key Color everywhere.");
+        Int_knob(f, &key_grid_columns_, "key_grid_columns", "Key Grid Columns");
+        SetRange(f, 2, 16);
+        Tooltip(f, "Samples per row of the key grid (2 to 16).");
+        
         Divider(f, "");
 
 	Newline(f);
@@ -254,7 +445,7 @@ public:
         static const char* keying_methods[] = {
             "Distance", "Chroma", "Luma Weighted", "Adaptive", nullptr
         };
-        Enumeration_knob(f, &keying_method_, keying_methods, "method", "Keying Method");
+        Enumeration_knob(f, &params_.keying_method, keying_methods, "method", "Keying Method");
         Tooltip(f, "Distance: Standard RGB distance (works with color expansion)\n"
                    "Chroma: Ignores brightness changes\n" 
                    "Luma Weighted: Considers brightness similarity\n"
@@ -262,33 +453,96 @@ public:
         
         Newline(f);
         
-        Float_knob(f, &gain_, IRange(0.0f, 5.0f), "gain", "Gain");
+        Float_knob(f, &params_.gain, IRange(0.0f, 5.0f), "gain", "Gain");
         Tooltip(f, "Alpha contrast adjustment. >1.0 increases contrast.");
         
-        Bool_knob(f, &invert_, "invert", "Invert");
+        Bool_knob(f, &params_.invert, "invert", "Invert");
         Tooltip(f, "Invert the generated matte.");
                 
         Newline(f);
         Divider(f, "6-Direction Color Expansion");
         
         BeginGroup(f, "Primary Colors");
-        Float_knob(f, &range_red_, IRange(-3.0f, 3.0f), "red_range", "Red");
+        Float_knob(f, &params_.range_red, IRange(-3.0f, 3.0f), "red_range", "Red");
         Tooltip(f, "Expand keying toward red (+) or away from red (-). Range: -3 to +3");
-        Float_knob(f, &range_green_, IRange(-3.0f, 3.0f), "green_range", "Green");
+        Float_knob(f, &params_.range_green, IRange(-3.0f, 3.0f), "green_range", "Green");
         Tooltip(f, "Expand keying toward green (+) or away from green (-). Range: -3 to +3");
-        Float_knob(f, &range_blue_, IRange(-3.0f, 3.0f), "blue_range", "Blue");
+        Float_knob(f, &params_.range_blue, IRange(-3.0f, 3.0f), "blue_range", "Blue");
         Tooltip(f, "Expand keying toward blue (+) or away from blue (-). Range: -3 to +3");
         EndGroup(f);
         
         BeginGroup(f, "Secondary Colors");
-        Float_knob(f, &range_yellow_, IRange(-3.0f, 3.0f), "yellow_range", "Yellow");
+        Float_knob(f, &params_.range_yellow, IRange(-3.0f, 3.0f), "yellow_range", "Yellow");
         Tooltip(f, "Expand keying toward yellow (+) or away from yellow (-). Range: -3 to +3");
-        Float_knob(f, &range_magenta_, IRange(-3.0f, 3.0f), "magenta_range", "Magenta");
+        Float_knob(f, &params_.range_magenta, IRange(-3.0f, 3.0f), "magenta_range", "Magenta");
         Tooltip(f, "Expand keying toward magenta (+) or away from magenta (-). Range: -3 to +3");
-        Float_knob(f, &range_cyan_, IRange(-3.0f, 3.0f), "cyan_range", "Cyan");
+        Float_knob(f, &params_.range_cyan, IRange(-3.0f, 3.0f), "cyan_range", "Cyan");
         Tooltip(f, "Expand keying toward cyan (+) or away from cyan (-). Range: -3 to +3");
         EndGroup(f);
         
+        Divider(f, "Noise");
+        
+        Bool_knob(f, &prefilter_, "prefilter", "Chroma Prefilter");
+        Tooltip(f, "Smooth the chroma of the input with an edge-preserving bilateral grid "
+                   "before keying, so grain on the screen does not make the matte noisy. "
+                   "Only the alpha is affected: RGB passes through unfiltered.");
+        Int_knob(f, &prefilter_size_, "prefilter_size", "Size");
+        SetRange(f, 8, 64);
+        Tooltip(f, "Spatial extent of the smoothing in pixels (minimum 8). Larger values "
+                   "remove coarser grain and need more rows of input per output row.");
+        Float_knob(f, &prefilter_range_, IRange(0.02f, 0.5f), "prefilter_range", "Edge Threshold");
+        Tooltip(f, "Chroma difference treated as an edge, in R-G and B-G separately. Colors "
+                   "further apart than this are not mixed, so lower values keep more edge "
+                   "detail; grain is smoothed only where it stays within it. Pixels more "
+                   "than five times this from the key color are keyed unfiltered.");
+        
+        Bool_knob(f, &adaptive_tolerance_, "adaptive_tolerance", "Adaptive Tolerance");
+        Tooltip(f, "Scale the tolerance of each pixel by the noise around it: the standard "
+                   "deviation of RGB over the noise window. Noisier areas get a looser key, "
+                   "clean areas a tighter one (a quarter to four times Tolerance). "
+                   "Needs the whole input frame.");
+        Int_knob(f, &noise_window_, "noise_window", "Noise Window");
+        SetRange(f, 1, 128);
+        Tooltip(f, "Radius in pixels of the window the noise is measured over. The cost does "
+                   "not depend on it.");
+        Float_knob(f, &noise_reference_, IRange(0.001f, 0.2f), "noise_reference", "Noise Reference");
+        Tooltip(f, "Noise level (RGB standard deviation) at which Tolerance applies as set.");
+        
+        Bool_knob(f, &local_screen_, "local_screen", "Local Screen");
+        Tooltip(f, "Key each pixel against the average color of the screen around it "
+                   "instead of the single Key Color, for unevenly lit screens without a "
+                   "clean plate. Pixels the global key gives an alpha of 0.5 or more count "
+                   "as screen. Needs the whole input frame.");
+        Int_knob(f, &screen_window_, "screen_window", "Screen Window");
+        SetRange(f, 8, 512);
+        Tooltip(f, "Radius in pixels of the window the screen color is averaged over. The "
+                   "cost does not depend on it; it should be well above the size of "
+                   "foreground detail.");
+        
+        Divider(f, "ID Mattes");
+        
+        static const char* id_modes[] = { "Off", "Index + Coverage", "Channels", nullptr };
+        Enumeration_knob(f, &id_mode_, id_modes, "id_mode", "ID Mode");
+        Tooltip(f, "Extract a matte per palette color from a flat-color ID pass in one pass. "
+                   "Index + Coverage writes id.index (the palette color's number, counting "
+                   "from 1; 0 where none is within tolerance) and id.coverage. Channels "
+                   "writes each color's matte to its own channel, idmatte0.red for the first "
+                   "color to idmatte15.alpha for the 64th.");
+        Multiline_String_knob(f, &id_palette_text_, "id_palette", "ID Palette", 4);
+        Tooltip(f, "Palette colors, \"r g b\" per color, up to 256 (64 in Channels mode).");
+        Float_knob(f, &id_tolerance_, IRange(0.001f, 0.5f), "id_tolerance", "ID Tolerance");
+        Tooltip(f, "RGB distance at which an ID matte falls to 0. Keep it below half the "
+                   "distance between the closest two palette colors.");
+        
+        Divider(f, "Matte Cache");
+        
+        Bool_knob(f, &cache_mattes_, "cache_mattes", "Cache Mattes");
+        Tooltip(f, "Keep computed mattes in a compressed in-memory cache so scrubbing "
+                   "back and forth does not re-key every frame. Cached edge values are "
+                   "stored to 1/65535 precision.");
+        Int_knob(f, &cache_size_mb_, "cache_size_mb", "Cache Size (MB)");
+        Tooltip(f, "Memory cap for the matte cache. Least recently viewed frames are dropped first.");
+        
         Divider(f, "");
         
         Text_knob(f, "Simple Color Keyer by Peter Mercell v2.0 2025");
@@ -0,0 +1,156 @@
+// SimpleColorKeyerArena.h - Per-thread bump arena for temporary row buffers
+//
+// engine() runs once per scanline on every render thread, so a std::vector
+// or new[] there is a heap allocation per row. ScratchArena hands out
+// 64-byte aligned spans from a block owned by the calling thread. Each
+// engine() call opens a ScratchArena::Scope, and everything taken within it
+// is released at once when the scope closes. The block only grows (to the
+// largest request seen), so once every thread has keyed its widest row,
+// rendering takes no heap memory here at all.
+//
+// The matte cache is the exception, outside the arena: a miss stores the
+// encoded row on the heap, and a miss on part of a row fetches the whole
+// row into a DDImage Row. Both happen once per row and frame, when the row
+// is first cached; hits allocate nothing.
+//
+// Scopes nest: input0().get() runs the upstream op's engine() on the same
+// thread, and when that is another SimpleColorKeyer its scope must not
+// release the spans the outer call still holds. A scope rewinds only to
+// where it started, and replaced blocks are freed only when the outermost
+// scope closes.
+//
+// ScratchArena::heap_allocations() counts block allocations across all
+// threads, and each one fires the arena_grow probe. The count stops
+// increasing once rendering reaches steady state; one that keeps climbing
+// means some path outgrows its arena on every call.
+#pragma once
+
+#include "SimpleColorKeyerProbes.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+class ScratchArena {
+public:
+    static const size_t kAlign = 64;
+
+    ScratchArena() = default;
+    ~ScratchArena() {
+        release_retired();
+        free_block(block_);
+    }
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    // The calling thread's arena
+    static ScratchArena& local() {
+        static thread_local ScratchArena arena;
+        return arena;
+    }
+
+    // Heap blocks allocated by all arenas since start-up
+    static uint64_t heap_allocations() { return counter().load(std::memory_order_relaxed); }
+
+    // Marks the calling thread's arena on construction and rewinds it to the
+    // mark on destruction
+    class Scope {
+    public:
+        Scope() : arena_(local()), block_(arena_.block_), used_(arena_.used_) { arena_.depth_++; }
+        ~Scope() {
+            if (--arena_.depth_ == 0) {
+                arena_.release_retired();
+                arena_.used_ = kAlign;
+            } else if (arena_.block_ == block_) {
+                arena_.used_ = used_;
+            } else {
+                // Grown within this scope: the current block holds nothing
+                // from outside it
+                arena_.used_ = kAlign;
+            }
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        ScratchArena& arena_;
+        uint8_t* block_;
+        size_t used_;
+    };
+
+    // Uninitialized, 64-byte aligned storage for 'count' T, valid until the
+    // innermost open Scope closes
+    template <class T>
+    T* alloc(size_t count) {
+        const size_t bytes = (count * sizeof(T) + kAlign - 1) & ~(kAlign - 1);
+        if (used_ + bytes > capacity_) grow(bytes);
+        T* p = reinterpret_cast<T*>(block_ + used_);
+        used_ += bytes;
+        return p;
+    }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    static std::atomic<uint64_t>& counter() {
+        static std::atomic<uint64_t> count(0);
+        return count;
+    }
+
+    // Each block starts with a 64-byte header holding the block it replaced.
+    // Spans handed out from a replaced block stay valid until the outermost
+    // Scope closes, which frees it; the new block is sized for everything in use, so the next
+    // pass through the same code fits in one block.
+    void grow(size_t bytes) {
+        size_t size = capacity_ ? capacity_ * 2 : 64 * 1024;
+        while (size < used_ + bytes + kAlign) size *= 2;
+        uint8_t* block = static_cast<uint8_t*>(alloc_block(size));
+        if (!block) throw std::bad_alloc();
+        const uint64_t total = counter().fetch_add(1, std::memory_order_relaxed) + 1;
+        SCK_PROBE2(arena_grow, size, total);
+        (void)total;
+        *reinterpret_cast<uint8_t**>(block) = block_;
+        block_ = block;
+        capacity_ = size;
+        used_ = kAlign;
+    }
+
+    void release_retired() {
+        if (!block_) return;
+        uint8_t*& prev = *reinterpret_cast<uint8_t**>(block_);
+        for (uint8_t* b = prev; b;) {
+            uint8_t* next = *reinterpret_cast<uint8_t**>(b);
+            free_block(b);
+            b = next;
+        }
+        prev = nullptr;
+    }
+
+    static void* alloc_block(size_t size) {
+#if defined(_WIN32)
+        return _aligned_malloc(size, kAlign);
+#else
+        void* p = nullptr;
+        return posix_memalign(&p, kAlign, size) == 0 ? p : nullptr;
+#endif
+    }
+
+    static void free_block(void* p) {
+#if defined(_WIN32)
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+
+    uint8_t* block_ = nullptr;
+    size_t capacity_ = 0;
+    size_t used_ = kAlign;
+    int depth_ = 0;             // Open scopes
+};
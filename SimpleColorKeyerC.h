@@ -0,0 +1,80 @@
+/* SimpleColorKeyerC.h - C ABI for the keying core
+ *
+ * A stable C interface to SimpleColorKeyerCore.h for other languages (the
+ * Python module in tools/python uses it). Images are described by one
+ * plane per channel - base pointer plus byte strides - so planar,
+ * interleaved and strided views of float32 or float16 data are read where
+ * they lie, without a copy. Alpha is computed with the same functions as
+ * the Nuke node, so the results are bit-identical for the same float
+ * input (half input is widened to float exactly, as Nuke does).
+ */
+#ifndef SIMPLE_COLOR_KEYER_C_H
+#define SIMPLE_COLOR_KEYER_C_H
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#  if defined(SCK_C_BUILD)
+#    define SCK_C_API __declspec(dllexport)
+#  else
+#    define SCK_C_API __declspec(dllimport)
+#  endif
+#else
+#  define SCK_C_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCK_API_VERSION 1
+
+typedef enum {
+    SCK_FLOAT32 = 0,
+    SCK_FLOAT16 = 1
+} sck_type;
+
+typedef enum {
+    SCK_OK = 0,
+    SCK_ERROR_ARGUMENT = 1,     /* null pointer, bad size or unknown method */
+    SCK_ERROR_TYPE = 2          /* unknown sample type */
+} sck_status;
+
+/* Knob values; sck_default_params() fills in the node's defaults */
+typedef struct {
+    float key_color[3];
+    float tolerance;
+    int method;                 /* 0 distance, 1 chroma, 2 luma weighted, 3 adaptive */
+    float gain;
+    int invert;
+    float red, green, blue;     /* 6-direction expansion, -3 to +3 */
+    float yellow, magenta, cyan;
+} sck_params;
+
+/* One channel of an image: sample (x, y) is at data + y * y_stride + x * x_stride */
+typedef struct {
+    const void* data;
+    ptrdiff_t x_stride;         /* bytes */
+    ptrdiff_t y_stride;         /* bytes */
+} sck_plane;
+
+SCK_C_API int sck_api_version(void);
+SCK_C_API void sck_default_params(sck_params* params);
+SCK_C_API const char* sck_status_string(int status);
+
+/* Alpha of one pixel */
+SCK_C_API float sck_key_pixel(const sck_params* params, float r, float g, float b);
+
+/* Key a width x height image whose R, G and B samples are described by
+ * rgb[0..2] and write float32 alpha to 'alpha' (strides in bytes). Uses
+ * 'threads' threads, or all CPUs when threads <= 0. Safe to call from any
+ * thread; concurrent calls share one worker pool and run one at a time. */
+SCK_C_API int sck_key_image(const sck_params* params, sck_type type, const sck_plane rgb[3],
+                            int width, int height, float* alpha, ptrdiff_t alpha_x_stride,
+                            ptrdiff_t alpha_y_stride, int threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,168 @@
+// SimpleColorKeyerCache.h - Compressed LRU cache of keyed mattes
+//
+// Holds computed alpha per (frame, knob hash) so scrubbing back and forth
+// through a shot does not re-key every frame. Rows are stored with the
+// run-length matte encoding from SimpleColorKeyerMatte.h (exact 0/1 runs,
+// unorm16 edge values), which typically brings a 4K matte down to a few
+// hundred KB. Whole frames are evicted least-recently-used once the cache
+// exceeds its memory cap.
+//
+// Rows are immutable once inserted, so lookups decode outside the lock
+// while holding a reference to the frame entry.
+#pragma once
+
+#include "SimpleColorKeyerMatte.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Fold the frame number into an op hash so identical knobs on different
+// frames get distinct cache keys
+inline uint64_t matte_cache_key(uint64_t hash, double frame) {
+    uint64_t bits;
+    memcpy(&bits, &frame, sizeof(bits));
+    uint64_t k = hash ^ (bits + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    return k;
+}
+
+class MatteCache {
+public:
+    explicit MatteCache(size_t capacity_bytes = 256u << 20) : capacity_(capacity_bytes) {}
+
+    void set_capacity(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        capacity_ = bytes;
+        evict_locked(nullptr);
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frames_.clear();
+        lru_.clear();
+        bytes_ = 0;
+    }
+
+    // Decode row y of the frame 'key' into 'out'. The row must have been
+    // stored with the same x0/width. Returns false on a miss.
+    bool get_row(uint64_t key, int y, int x0, int width, float* out) {
+        std::shared_ptr<Frame> frame;
+        const std::vector<uint8_t>* data = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = frames_.find(key);
+            if (it == frames_.end()) {
+                misses_++;
+                return false;
+            }
+            frame = it->second.frame;
+            if (frame->x0 != x0 || frame->width != width || y < frame->y0 ||
+                y >= frame->y0 + (int)frame->rows.size() || !frame->present[y - frame->y0]) {
+                misses_++;
+                return false;
+            }
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+            data = &frame->rows[y - frame->y0];
+            hits_++;
+        }
+        return decode_matte_row(data->data(), data->size(), width, MATTE_UNORM16, out);
+    }
+
+    // Store row y of the frame 'key', whose rows span [y0, y0 + height).
+    // 'alpha' is replaced by the stored (16-bit quantized) values, so a miss
+    // renders exactly what a later hit on the same row returns.
+    void put_row(uint64_t key, int y0, int height, int x0, int width, int y, float* alpha) {
+        if (y < y0 || y >= y0 + height) return;
+        std::vector<uint8_t> encoded;
+        encoded.reserve(64);
+        encode_matte_row(alpha, width, MATTE_UNORM16, encoded);
+        encoded.shrink_to_fit();
+        decode_matte_row(encoded.data(), encoded.size(), width, MATTE_UNORM16, alpha);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = frames_.find(key);
+        if (it == frames_.end() || it->second.frame->x0 != x0 || it->second.frame->width != width ||
+            it->second.frame->y0 != y0 || (int)it->second.frame->rows.size() != height) {
+            if (it != frames_.end()) erase_locked(it);
+            std::shared_ptr<Frame> frame(new Frame());
+            frame->x0 = x0;
+            frame->width = width;
+            frame->y0 = y0;
+            frame->rows.resize(height);
+            frame->present.assign(height, 0);
+            lru_.push_front(key);
+            Entry entry;
+            entry.frame = frame;
+            entry.lru = lru_.begin();
+            entry.bytes = sizeof(Frame) + height * (sizeof(std::vector<uint8_t>) + 1);
+            bytes_ += entry.bytes;
+            it = frames_.emplace(key, entry).first;
+        }
+        Frame& frame = *it->second.frame;
+        if (frame.present[y - y0]) return;   // another thread got there first
+        it->second.bytes += encoded.capacity();
+        bytes_ += encoded.capacity();
+        frame.rows[y - y0].swap(encoded);
+        frame.present[y - y0] = 1;
+        evict_locked(&it->second);
+    }
+
+    size_t bytes() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return bytes_;
+    }
+    // Counted under the lock by render threads, so read under it too
+    uint64_t hits() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return hits_;
+    }
+    uint64_t misses() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return misses_;
+    }
+
+private:
+    struct Frame {
+        int x0 = 0, width = 0, y0 = 0;
+        std::vector<std::vector<uint8_t>> rows;
+        std::vector<uint8_t> present;
+    };
+    struct Entry {
+        std::shared_ptr<Frame> frame;
+        std::list<uint64_t>::iterator lru;
+        size_t bytes = 0;
+    };
+    typedef std::unordered_map<uint64_t, Entry> FrameMap;
+
+    void erase_locked(FrameMap::iterator it) {
+        bytes_ -= it->second.bytes;
+        lru_.erase(it->second.lru);
+        frames_.erase(it);
+    }
+
+    // Drop least-recently-used frames until under the cap, sparing 'keep'
+    void evict_locked(const Entry* keep) {
+        while (bytes_ > capacity_ && !lru_.empty()) {
+            auto it = frames_.find(lru_.back());
+            if (&it->second == keep) {
+                if (lru_.size() == 1) return;
+                // The frame being filled is the oldest - evict the next one
+                lru_.splice(lru_.begin(), lru_, it->second.lru);
+                continue;
+            }
+            erase_locked(it);
+        }
+    }
+
+    mutable std::mutex mutex_;
+    FrameMap frames_;
+    std::list<uint64_t> lru_;      // most recently used first
+    size_t capacity_;
+    size_t bytes_ = 0;
+    uint64_t hits_ = 0, misses_ = 0;
+};
@@ -0,0 +1,252 @@
+// SimpleColorKeyerCore.h - DDImage-independent keying math
+//
+// The Nuke plugin and the standalone tools share these functions so that a
+// matte computed outside Nuke is identical to the one the node produces.
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+
+struct Color3 {
+    float r, g, b;
+    Color3() : r(0), g(0), b(0) {}
+    Color3(float r_, float g_, float b_) : r(r_), g(g_), b(b_) {}
+    float distance_to(const Color3& other) const {
+        float dr = r - other.r;
+        float dg = g - other.g;
+        float db = b - other.b;
+        return sqrt(dr*dr + dg*dg + db*db);
+    }
+};
+
+// Keying methods, in the order of the "method" enumeration knob
+enum KeyingMethod {
+    KEY_DISTANCE = 0,
+    KEY_CHROMA = 1,
+    KEY_LUMA_WEIGHTED = 2,
+    KEY_ADAPTIVE = 3
+};
+
+// Every knob value that influences the alpha
+struct KeyerParams {
+    float key_color[3];         // RGB color to key
+    float variance;             // Color variance/tolerance
+    float range_red;            // Red direction (-3 to +3)
+    float range_magenta;        // Magenta direction (-3 to +3)
+    float range_green;          // Green direction (-3 to +3)
+    float range_yellow;         // Yellow direction (-3 to +3)
+    float range_blue;           // Blue direction (-3 to +3)
+    float range_cyan;           // Cyan direction (-3 to +3)
+    float gain;                 // Alpha gain/contrast
+    bool invert;                // Invert the matte
+    int keying_method;          // 0=distance, 1=chroma, 2=luma weighted, 3=adaptive
+
+    KeyerParams() {
+        // Default green screen color
+        key_color[0] = 0.0f;    // Red
+        key_color[1] = 1.0f;    // Green
+        key_color[2] = 0.0f;    // Blue
+
+        variance = 0.3f;        // 30% tolerance
+        range_red = 0.0f;       // No red expansion
+        range_magenta = 0.0f;   // No magenta expansion
+        range_green = 0.0f;     // No green expansion
+        range_yellow = 0.0f;    // No yellow expansion
+        range_blue = 0.0f;      // No blue expansion
+        range_cyan = 0.0f;      // No cyan expansion
+        gain = 1.0f;            // No gain adjustment
+        invert = false;         // Normal matte
+        keying_method = KEY_DISTANCE;
+    }
+
+    Color3 key() const { return Color3(key_color[0], key_color[1], key_color[2]); }
+};
+
+inline float calculate_distance_alpha(const KeyerParams& p, const Color3& pixel, const Color3& key) {
+    // Calculate how much this pixel matches each of the 6 color directions
+    float red_match = pixel.r;                           // Pure red component
+    float green_match = pixel.g;                         // Pure green component
+    float blue_match = pixel.b;                          // Pure blue component
+    float yellow_match = std::min(pixel.r, pixel.g);     // Yellow = min(R,G)
+    float magenta_match = std::min(pixel.r, pixel.b);    // Magenta = min(R,B)
+    float cyan_match = std::min(pixel.g, pixel.b);       // Cyan = min(G,B)
+
+    // Calculate base distance
+    float base_distance = pixel.distance_to(key);
+
+    // Start with base tolerance
+    float effective_tolerance = p.variance;
+
+    // Add tolerance expansion based on how much the pixel matches each color direction
+    if (p.range_red > 0.0f) {
+        effective_tolerance += p.range_red * 0.1f * red_match;
+    }
+    if (p.range_green > 0.0f) {
+        effective_tolerance += p.range_green * 0.1f * green_match;
+    }
+    if (p.range_blue > 0.0f) {
+        effective_tolerance += p.range_blue * 0.1f * blue_match;
+    }
+    if (p.range_yellow > 0.0f) {
+        effective_tolerance += p.range_yellow * 0.1f * yellow_match;
+    }
+    if (p.range_magenta > 0.0f) {
+        effective_tolerance += p.range_magenta * 0.1f * magenta_match;
+    }
+    if (p.range_cyan > 0.0f) {
+        effective_tolerance += p.range_cyan * 0.1f * cyan_match;
+    }
+
+    // Handle negative values (contract tolerance for those colors)
+    if (p.range_red < 0.0f) {
+        effective_tolerance += p.range_red * 0.1f * red_match; // This will subtract
+    }
+    if (p.range_green < 0.0f) {
+        effective_tolerance += p.range_green * 0.1f * green_match;
+    }
+    if (p.range_blue < 0.0f) {
+        effective_tolerance += p.range_blue * 0.1f * blue_match;
+    }
+    if (p.range_yellow < 0.0f) {
+        effective_tolerance += p.range_yellow * 0.1f * yellow_match;
+    }
+    if (p.range_magenta < 0.0f) {
+        effective_tolerance += p.range_magenta * 0.1f * magenta_match;
+    }
+    if (p.range_cyan < 0.0f) {
+        effective_tolerance += p.range_cyan * 0.1f * cyan_match;
+    }
+
+    // Ensure minimum tolerance
+    effective_tolerance = std::max(0.001f, effective_tolerance);
+
+    // Calculate final alpha
+    float normalized_distance = base_distance / effective_tolerance;
+    return std::max(0.0f, 1.0f - normalized_distance);
+}
+
+// Chroma alpha from precomputed (R-G, B-G) differences
+inline float chroma_alpha_uv(const KeyerParams& p, float pixel_u, float pixel_v, float key_u, float key_v) {
+    float chroma_distance = sqrtf((pixel_u - key_u) * (pixel_u - key_u) +
+                                  (pixel_v - key_v) * (pixel_v - key_v));
+    float normalized_distance = chroma_distance / p.variance;
+    return std::max(0.0f, 1.0f - normalized_distance);
+}
+
+inline float calculate_chroma_alpha(const KeyerParams& p, const Color3& pixel, const Color3& key) {
+    // Convert to YUV-like space to ignore luminance
+    float pixel_u = pixel.r - pixel.g;
+    float pixel_v = pixel.b - pixel.g;
+    float key_u = key.r - key.g;
+    float key_v = key.b - key.g;
+
+    return chroma_alpha_uv(p, pixel_u, pixel_v, key_u, key_v);
+}
+
+inline float luma_of(const Color3& c) {
+    return 0.299f * c.r + 0.587f * c.g + 0.114f * c.b;
+}
+
+// Weight that fades the distance alpha out as brightness departs from the key
+inline float luma_weight(float pixel_luma, float key_luma) {
+    float luma_diff = std::abs(pixel_luma - key_luma);
+    return 1.0f - std::min(1.0f, luma_diff / 0.5f);
+}
+
+inline float calculate_luma_weighted_alpha(const KeyerParams& p, const Color3& pixel, const Color3& key) {
+    float weight = luma_weight(luma_of(pixel), luma_of(key));
+
+    float color_alpha = calculate_distance_alpha(p, pixel, key);
+    return color_alpha * weight;
+}
+
+// Blend used by the adaptive method once both alphas are known
+inline float adaptive_blend(float distance_alpha, float chroma_alpha, const Color3& key) {
+    // Weight based on how saturated the key color is
+    float key_saturation = std::max({key.r, key.g, key.b}) - std::min({key.r, key.g, key.b});
+
+    if (key_saturation > 0.5f) {
+        // Highly saturated key color - prefer chroma keying
+        return 0.3f * distance_alpha + 0.7f * chroma_alpha;
+    } else {
+        // Less saturated key color - prefer distance keying
+        return 0.7f * distance_alpha + 0.3f * chroma_alpha;
+    }
+}
+
+inline float calculate_adaptive_alpha(const KeyerParams& p, const Color3& pixel, const Color3& key) {
+    float distance_alpha = calculate_distance_alpha(p, pixel, key);
+    float chroma_alpha = calculate_chroma_alpha(p, pixel, key);
+    return adaptive_blend(distance_alpha, chroma_alpha, key);
+}
+
+// Intelligent alpha calculation based on keying method
+inline float calculate_alpha(const KeyerParams& p, const Color3& pixel, const Color3& key) {
+    float alpha = 0.0f;
+
+    switch (p.keying_method) {
+        case KEY_DISTANCE: // Distance-based (default)
+            alpha = calculate_distance_alpha(p, pixel, key);
+            break;
+        case KEY_CHROMA: // Chroma-based (ignore luminance)
+            alpha = calculate_chroma_alpha(p, pixel, key);
+            break;
+        case KEY_LUMA_WEIGHTED: // Luma-weighted
+            alpha = calculate_luma_weighted_alpha(p, pixel, key);
+            break;
+        case KEY_ADAPTIVE: // Adaptive (combines multiple methods)
+            alpha = calculate_adaptive_alpha(p, pixel, key);
+            break;
+    }
+
+    return alpha;
+}
+
+// Gain, clamp and invert - the final steps engine() applies to every pixel
+inline float finish_alpha(const KeyerParams& p, float alpha) {
+    alpha = alpha * p.gain;
+    alpha = std::max(0.0f, std::min(1.0f, alpha));
+
+    if (p.invert) {
+        alpha = 1.0f - alpha;
+    }
+    return alpha;
+}
+
+// Full per-pixel key: method, gain, clamp and invert
+inline float key_pixel(const KeyerParams& p, const Color3& pixel, const Color3& key) {
+    return finish_alpha(p, calculate_alpha(p, pixel, key));
+}
+
+// Key a row of planar float RGB into an alpha row
+inline void key_row(const KeyerParams& p, const float* r, const float* g, const float* b,
+                    float* alpha, int count) {
+    Color3 key = p.key();
+    for (int i = 0; i < count; i++) {
+        alpha[i] = key_pixel(p, Color3(r[i], g[i], b[i]), key);
+    }
+}
+
+// Key a row against a per-pixel key color, such as a row of a clean plate
+inline void key_row_plate(const KeyerParams& p, const float* r, const float* g, const float* b,
+                          const float* key_r, const float* key_g, const float* key_b,
+                          float* alpha, int count) {
+    for (int i = 0; i < count; i++) {
+        alpha[i] = key_pixel(p, Color3(r[i], g[i], b[i]), Color3(key_r[i], key_g[i], key_b[i]));
+    }
+}
+
+// Key a row with a per-pixel key color (such as a local screen estimate)
+// and/or a per-pixel tolerance (such as one scaled by the local noise) in
+// place of the knob values; pass null for either to use the knob value
+inline void key_row_local(const KeyerParams& p, const float* r, const float* g, const float* b,
+                          const float* key_r, const float* key_g, const float* key_b,
+                          const float* tolerance, float* alpha, int count) {
+    Color3 key = p.key();
+    KeyerParams q = p;
+    for (int i = 0; i < count; i++) {
+        if (key_r) key = Color3(key_r[i], key_g[i], key_b[i]);
+        if (tolerance) q.variance = tolerance[i];
+        alpha[i] = key_pixel(q, Color3(r[i], g[i], b[i]), key);
+    }
+}
@@ -0,0 +1,213 @@
+// SimpleColorKeyerIdMatte.h - Many-color ID mattes in one pass
+//
+// A flat-color ID pass holds one color per object. Instead of keying it
+// once per object, IdPalette finds the nearest palette color to each pixel
+// and its coverage, 1 - distance / tolerance as in the Distance method, so
+// every matte comes out of a single pass over the frame.
+//
+// The nearest-color search has two forms:
+//
+//   - brute force, for small palettes: pixels are taken kBlock at a time
+//     and every palette color is compared against the whole block, so
+//     the inner loop runs across pixels with a fixed trip count and the
+//     compiler vectorizes it (SSE/AVX/NEON, whatever the target has)
+//   - a uniform grid over RGB, for large ones: cells are at least the
+//     tolerance wide, so any color within tolerance of a pixel lies in the
+//     3x3x3 cells around it, and a pixel more than a cell outside the
+//     palette's bounding box matches nothing without a search
+//
+// Both give the same matte, up to rounding where the compiler fuses the
+// vectorized distance into FMAs; ties go to the lower index. SEARCH_AUTO
+// picks brute force up to kBruteForceMax colors; SimpleColorKeyerMicroBench
+// --id-matte measures the crossover.
+#pragma once
+
+#include "SimpleColorKeyerCore.h"
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+class IdPalette {
+public:
+    static constexpr int kMaxColors = 256;
+    static constexpr int kBruteForceMax = 16;
+    static constexpr int kBlock = 16;           // pixels per brute-force block
+    static constexpr int kMaxCells = 32;        // grid cells per axis at most
+
+    enum Search { SEARCH_AUTO, SEARCH_BRUTE, SEARCH_GRID };
+
+    IdPalette() : tolerance_(0.05f), dims_(0), cell_(1.0f), origin_{ 0.0f, 0.0f, 0.0f } {}
+
+    // Parse 'text': "r g b" triplets, separated by spaces, commas or
+    // newlines, one per palette color. Returns an error message, or an
+    // empty string.
+    std::string parse(const char* text, float tolerance) {
+        std::vector<float> values;
+        for (const char* p = text ? text : ""; *p;) {
+            char* end;
+            const float v = strtof(p, &end);
+            if (end == p) {
+                if (*p != ' ' && *p != ',' && *p != '\t' && *p != '\n' && *p != '\r') {
+                    return std::string("unexpected '") + *p + "' in ID palette";
+                }
+                p++;
+                continue;
+            }
+            values.push_back(v);
+            p = end;
+        }
+        if (values.size() % 3 != 0) return "ID palette needs three values (r g b) per color";
+        if (values.size() / 3 > (size_t)kMaxColors) return "ID palette holds at most 256 colors";
+        std::vector<Color3> colors;
+        for (size_t i = 0; i < values.size(); i += 3) colors.push_back(Color3(values[i], values[i + 1], values[i + 2]));
+        set(colors, tolerance);
+        return std::string();
+    }
+
+    void set(const std::vector<Color3>& colors, float tolerance) {
+        colors_ = colors;
+        tolerance_ = std::max(1e-4f, tolerance);
+        build_grid();
+    }
+
+    int size() const { return (int)colors_.size(); }
+    const Color3& color(int i) const { return colors_[i]; }
+    float tolerance() const { return tolerance_; }
+
+    // For each pixel: the nearest palette color within tolerance, or -1,
+    // and its coverage (0 where there is no match)
+    void match_row(const float* r, const float* g, const float* b, int count, int* index, float* coverage,
+                   Search search = SEARCH_AUTO) const {
+        if (colors_.empty()) {
+            std::fill(index, index + count, -1);
+            std::fill(coverage, coverage + count, 0.0f);
+            return;
+        }
+        if (search == SEARCH_BRUTE || (search == SEARCH_AUTO && size() <= kBruteForceMax)) {
+            match_brute(r, g, b, count, index, coverage);
+        } else {
+            match_grid(r, g, b, count, index, coverage);
+        }
+    }
+
+private:
+    float coverage_of(float d2) const { return std::max(0.0f, 1.0f - std::sqrt(d2) / tolerance_); }
+
+    void match_brute(const float* r, const float* g, const float* b, int count, int* index,
+                     float* coverage) const {
+        const float limit = tolerance_ * tolerance_;
+        for (int i0 = 0; i0 < count; i0 += kBlock) {
+            const int m = std::min(kBlock, count - i0);
+            float pr[kBlock], pg[kBlock], pb[kBlock], best[kBlock];
+            int idx[kBlock];
+            for (int j = 0; j < kBlock; j++) {
+                const int i = i0 + std::min(j, m - 1);
+                pr[j] = r[i];
+                pg[j] = g[i];
+                pb[j] = b[i];
+                best[j] = limit;
+                idx[j] = -1;
+            }
+            for (int k = 0; k < size(); k++) {
+                const float cr = colors_[k].r, cg = colors_[k].g, cb = colors_[k].b;
+                for (int j = 0; j < kBlock; j++) {
+                    const float dr = pr[j] - cr, dg = pg[j] - cg, db = pb[j] - cb;
+                    const float d2 = dr * dr + dg * dg + db * db;
+                    const bool nearer = d2 < best[j];
+                    best[j] = nearer ? d2 : best[j];
+                    idx[j] = nearer ? k : idx[j];
+                }
+            }
+            for (int j = 0; j < m; j++) {
+                index[i0 + j] = idx[j];
+                coverage[i0 + j] = idx[j] < 0 ? 0.0f : coverage_of(best[j]);
+            }
+        }
+    }
+
+    void match_grid(const float* r, const float* g, const float* b, int count, int* index,
+                    float* coverage) const {
+        const float limit = tolerance_ * tolerance_;
+        for (int i = 0; i < count; i++) {
+            int c[3];
+            if (!pixel_cell(r[i], g[i], b[i], c)) {
+                index[i] = -1;
+                coverage[i] = 0.0f;
+                continue;
+            }
+            float best = limit;
+            int best_index = -1;
+            for (int z = std::max(0, c[2] - 1); z <= std::min(dims_ - 1, c[2] + 1); z++) {
+                for (int y = std::max(0, c[1] - 1); y <= std::min(dims_ - 1, c[1] + 1); y++) {
+                    for (int x = std::max(0, c[0] - 1); x <= std::min(dims_ - 1, c[0] + 1); x++) {
+                        const int cell = (z * dims_ + y) * dims_ + x;
+                        for (int n = cell_start_[cell]; n < cell_start_[cell + 1]; n++) {
+                            const int k = cell_items_[n];
+                            const float dr = r[i] - colors_[k].r, dg = g[i] - colors_[k].g, db = b[i] - colors_[k].b;
+                            const float d2 = dr * dr + dg * dg + db * db;
+                            if (d2 < best || (d2 == best && best_index >= 0 && k < best_index)) {
+                                best = d2;
+                                best_index = k;
+                            }
+                        }
+                    }
+                }
+            }
+            index[i] = best_index;
+            coverage[i] = best_index < 0 ? 0.0f : coverage_of(best);
+        }
+    }
+
+    // Grid cell of a pixel, which may lie one cell outside the grid; false
+    // when it is further out, where no palette color is within tolerance
+    bool pixel_cell(float r, float g, float b, int c[3]) const {
+        const float v[3] = { r, g, b };
+        for (int a = 0; a < 3; a++) {
+            const float f = (v[a] - origin_[a]) / cell_;
+            if (!(f >= -1.0f && f < (float)(dims_ + 1))) return false;
+            c[a] = (int)std::floor(f);
+        }
+        return true;
+    }
+
+    // Cells a little wider than the tolerance over the palette's bounding
+    // box; colors are listed per cell in index order
+    void build_grid() {
+        float lo[3] = { 0.0f, 0.0f, 0.0f }, hi[3] = { 0.0f, 0.0f, 0.0f };
+        for (size_t k = 0; k < colors_.size(); k++) {
+            const float v[3] = { colors_[k].r, colors_[k].g, colors_[k].b };
+            for (int a = 0; a < 3; a++) {
+                lo[a] = k ? std::min(lo[a], v[a]) : v[a];
+                hi[a] = k ? std::max(hi[a], v[a]) : v[a];
+            }
+        }
+        float extent = 0.0f;
+        for (int a = 0; a < 3; a++) extent = std::max(extent, hi[a] - lo[a]);
+        cell_ = std::max(tolerance_, extent / (kMaxCells - 1)) * 1.001f;
+        dims_ = colors_.empty() ? 0 : std::min(kMaxCells, (int)(extent / cell_) + 1);
+        for (int a = 0; a < 3; a++) origin_[a] = lo[a];
+
+        const size_t cells = (size_t)dims_ * dims_ * dims_;
+        std::vector<int> cell_index(colors_.size());
+        cell_start_.assign(cells + 1, 0);
+        for (size_t k = 0; k < colors_.size(); k++) {
+            const float v[3] = { colors_[k].r, colors_[k].g, colors_[k].b };
+            int c[3];
+            for (int a = 0; a < 3; a++) c[a] = std::min(std::max((int)((v[a] - origin_[a]) / cell_), 0), dims_ - 1);
+            cell_index[k] = (c[2] * dims_ + c[1]) * dims_ + c[0];
+            cell_start_[cell_index[k] + 1]++;
+        }
+        for (size_t i = 0; i < cells; i++) cell_start_[i + 1] += cell_start_[i];
+        cell_items_.assign(colors_.size(), 0);
+        std::vector<int> fill(cell_start_.begin(), cell_start_.end() - 1);
+        for (size_t k = 0; k < colors_.size(); k++) cell_items_[fill[cell_index[k]]++] = (int)k;
+    }
+
+    std::vector<Color3> colors_;
+    float tolerance_;
+    int dims_;
+    float cell_;
+    float origin_[3];
+    std::vector<int> cell_start_, cell_items_;
+};
@@ -0,0 +1,139 @@
+// SimpleColorKeyerKeyGrid.h - Sparse grid of key colors across the frame
+//
+// A screen that darkens toward the corners needs more than one key color,
+// but rarely a whole clean plate. KeyGrid holds a small grid of picked
+// colors (2x2 up to 16x16) spread evenly over the frame, from corner to
+// corner, and keys each pixel against their bilinear interpolation.
+//
+// The interpolation is incremental: for row y, each grid column is first
+// blended vertically (once per row, 'columns' lerps), and between two grid
+// columns the key color then changes by a constant step per pixel, so the
+// kernel adds three floats per pixel on top of key_pixel().
+#pragma once
+
+#include "SimpleColorKeyerCore.h"
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+class KeyGrid {
+public:
+    static constexpr int kMinSize = 2;
+    static constexpr int kMaxSize = 16;
+
+    KeyGrid() : columns_(0), rows_(0), x0_(0), y0_(0), width_(0), height_(0) {}
+
+    // Parse 'text': rows of "r g b" triplets (commas also separate), the top
+    // row of the frame first, 'columns' colors per row. Returns an error
+    // message, or an empty string.
+    std::string parse(const char* text, int columns) {
+        colors_.clear();
+        std::vector<float> values;
+        for (const char* p = text ? text : ""; *p;) {
+            char* end;
+            const float v = strtof(p, &end);
+            if (end == p) {
+                if (*p != ' ' && *p != ',' && *p != '\t' && *p != '\n' && *p != '\r') {
+                    return std::string("unexpected '") + *p + "' in key grid";
+                }
+                p++;
+                continue;
+            }
+            values.push_back(v);
+            p = end;
+        }
+        if (columns < kMinSize || columns > kMaxSize) return "key grid columns must be 2 to 16";
+        if (values.size() % 3 != 0) return "key grid needs three values (r g b) per color";
+        const int count = (int)values.size() / 3;
+        if (count % columns != 0 || count / columns < kMinSize || count / columns > kMaxSize) {
+            return "key grid needs 2 to 16 full rows of " + std::to_string(columns) + " colors";
+        }
+        columns_ = columns;
+        rows_ = count / columns;
+        // Stored bottom row first, as Nuke's y axis runs up
+        colors_.resize(count);
+        for (int gy = 0; gy < rows_; gy++) {
+            for (int gx = 0; gx < columns_; gx++) {
+                const float* v = &values[((size_t)(rows_ - 1 - gy) * columns_ + gx) * 3];
+                colors_[(size_t)gy * columns_ + gx] = Color3(v[0], v[1], v[2]);
+            }
+        }
+        return std::string();
+    }
+
+    bool empty() const { return colors_.empty(); }
+    int columns() const { return columns_; }
+    int rows() const { return rows_; }
+
+    // The frame the grid spans: its corner colors sit on the corner pixels
+    void set_frame(int x0, int y0, int width, int height) {
+        x0_ = x0;
+        y0_ = y0;
+        width_ = width;
+        height_ = height;
+    }
+
+    // Row y's key color at each grid column, into 'column_keys' (columns()
+    // entries)
+    void column_keys(int y, Color3* column_keys) const {
+        const float fy = std::min(std::max((float)(y - y0_) / std::max(1, height_ - 1), 0.0f), 1.0f) * (rows_ - 1);
+        const int gy = std::min((int)fy, rows_ - 2);
+        const float t = fy - gy;
+        const Color3* below = &colors_[(size_t)gy * columns_];
+        const Color3* above = below + columns_;
+        for (int gx = 0; gx < columns_; gx++) {
+            column_keys[gx] = Color3(below[gx].r + t * (above[gx].r - below[gx].r),
+                                     below[gx].g + t * (above[gx].g - below[gx].g),
+                                     below[gx].b + t * (above[gx].b - below[gx].b));
+        }
+    }
+
+    // Call fn(i, key) for pixels [x, r) with the key color interpolated
+    // along the row from 'column_keys', stepping it incrementally
+    template <class F>
+    void walk_row(const Color3* column_keys, int x, int r, const F& fn) const {
+        const float scale = (float)(columns_ - 1) / std::max(1, width_ - 1);
+        const int n = r - x;
+        int i = 0;
+        // Beyond the frame the key stays at the edge color
+        for (; i < n && x + i < x0_; i++) fn(i, column_keys[0]);
+        while (i < n && x + i < x0_ + width_) {
+            // The segment between grid columns gx and gx + 1 holding this pixel
+            const int px = x + i - x0_;
+            const float fx = px * scale;
+            const int gx = std::min((int)fx, columns_ - 2);
+            const int next = gx + 2 < columns_ ? (int)std::ceil((gx + 1) / scale) : width_;
+            const int end = std::min(n, x0_ + std::max(next, px + 1) - x);
+            const Color3& a = column_keys[gx];
+            const Color3& b = column_keys[gx + 1];
+            const float t = fx - gx;
+            Color3 key(a.r + t * (b.r - a.r), a.g + t * (b.g - a.g), a.b + t * (b.b - a.b));
+            const Color3 step((b.r - a.r) * scale, (b.g - a.g) * scale, (b.b - a.b) * scale);
+            for (; i < end; i++) {
+                fn(i, key);
+                key.r += step.r;
+                key.g += step.g;
+                key.b += step.b;
+            }
+        }
+        for (; i < n; i++) fn(i, column_keys[columns_ - 1]);
+    }
+
+private:
+    int columns_, rows_;
+    int x0_, y0_, width_, height_;
+    std::vector<Color3> colors_;
+};
+
+// Key a row against a KeyGrid: the whole per-pixel cost over key_row() is
+// stepping the interpolated key color. 'column_keys' is scratch for
+// grid.columns() colors.
+inline void key_row_grid(const KeyerParams& p, const KeyGrid& grid, int y, int x, int r,
+                         const float* red, const float* green, const float* blue, float* alpha,
+                         Color3* column_keys) {
+    grid.column_keys(y, column_keys);
+    grid.walk_row(column_keys, x, r, [&](int i, const Color3& key) {
+        alpha[i] = key_pixel(p, Color3(red[i], green[i], blue[i]), key);
+    });
+}
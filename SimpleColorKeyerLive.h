@@ -0,0 +1,251 @@
+// SimpleColorKeyerLive.h - Low-latency live keying on a persistent thread pool
+//
+// LiveKeyer keys whole frames with a bounded, predictable latency:
+//   - worker threads are created once and optionally pinned to CPUs,
+//     so nothing is spawned per frame; the calling thread is only pinned
+//     on request (pin_caller), since that binding outlives the keyer
+//   - each frame is split into row bands that workers (and the calling
+//     thread) claim from a shared counter, which absorbs uneven rows
+//   - the alpha buffer is allocated up front and reused every frame
+//   - every frame's latency is recorded into a LatencyHistogram
+#pragma once
+
+#include "SimpleColorKeyerCore.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Log-linear latency histogram in microseconds: exact below 64us, then 64
+// sub-buckets per power of two (~1.5% resolution) up to ~17 minutes.
+class LatencyHistogram {
+public:
+    LatencyHistogram() : counts_(kBuckets, 0), total_(0), max_us_(0) {}
+
+    void record(double microseconds) {
+        uint64_t us = microseconds <= 0.0 ? 0 : (uint64_t)microseconds;
+        counts_[bucket_of(us)]++;
+        total_++;
+        max_us_ = std::max(max_us_, us);
+    }
+
+    // Lower bound of the bucket holding quantile q (0..1), in microseconds
+    double percentile(double q) const {
+        if (total_ == 0) return 0.0;
+        uint64_t target = (uint64_t)(q * (double)(total_ - 1)) + 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; i++) {
+            seen += counts_[i];
+            if (seen >= target) return (double)bucket_floor(i);
+        }
+        return (double)max_us_;
+    }
+
+    uint64_t count() const { return total_; }
+    double max() const { return (double)max_us_; }
+
+    // Upper bound on the frames slower than the given budget: a bucket
+    // counts when any part of it lies above the budget, so frames in the
+    // bucket straddling the budget are included
+    uint64_t count_above(double microseconds) const {
+        uint64_t above = 0;
+        for (int i = 0; i < kBuckets; i++) {
+            if ((double)bucket_ceiling(i) > microseconds) above += counts_[i];
+        }
+        return above;
+    }
+
+    void reset() {
+        std::fill(counts_.begin(), counts_.end(), 0);
+        total_ = 0;
+        max_us_ = 0;
+    }
+
+private:
+    static const int kSubBits = 6;
+    static const int kBuckets = (40 - kSubBits + 1) << kSubBits;
+
+    static int bucket_of(uint64_t us) {
+        if (us < (1u << kSubBits)) return (int)us;
+        int e = 63 - __builtin_clzll(us);
+        if (e >= 40) return kBuckets - 1;
+        int sub = (int)((us >> (e - kSubBits)) & ((1u << kSubBits) - 1));
+        return ((e - kSubBits + 1) << kSubBits) + sub;
+    }
+
+    static uint64_t bucket_floor(int i) {
+        if (i < (1 << kSubBits)) return (uint64_t)i;
+        int e = (i >> kSubBits) + kSubBits - 1;
+        uint64_t sub = (uint64_t)(i & ((1 << kSubBits) - 1));
+        return ((uint64_t)1 << e) | (sub << (e - kSubBits));
+    }
+
+    // Exclusive upper edge of bucket i; the last bucket is open-ended
+    static double bucket_ceiling(int i) {
+        if (i + 1 >= kBuckets) return HUGE_VAL;
+        return (double)bucket_floor(i + 1);
+    }
+
+    std::vector<uint64_t> counts_;
+    uint64_t total_;
+    uint64_t max_us_;
+};
+
+class LiveKeyer {
+public:
+    // threads: total threads keying a frame, including the caller.
+    // pin: bind worker i to CPU i (Linux only; ignored elsewhere). The
+    // calling thread is left alone; see pin_caller().
+    LiveKeyer(int width, int height, int threads, bool pin = true)
+        : width_(width), height_(height), alpha_((size_t)width * height),
+          generation_(0), work_(0), bands_done_(0), stop_(false) {
+        threads = std::max(1, threads);
+        // A few bands per thread lets fast workers pick up slack
+        band_rows_ = std::max(1, height / (threads * 4));
+        band_count_ = (height + band_rows_ - 1) / band_rows_;
+
+        for (int i = 1; i < threads; i++) {
+            workers_.emplace_back([this, i, pin] {
+                if (pin) pin_to_cpu(i);
+                worker_loop();
+            });
+        }
+    }
+
+    ~LiveKeyer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& t : workers_) t.join();
+    }
+
+    LiveKeyer(const LiveKeyer&) = delete;
+    LiveKeyer& operator=(const LiveKeyer&) = delete;
+
+    // Only call between frames
+    void set_params(const KeyerParams& params) { params_ = params; }
+
+    // Key one planar float frame. 'stride' is in floats per row. Returns the
+    // internal alpha buffer, valid until the next call.
+    const float* key(const float* r, const float* g, const float* b, size_t stride) {
+        auto start = std::chrono::steady_clock::now();
+
+        r_ = r; g_ = g; b_ = b; stride_ = stride;
+        bands_done_.store(0, std::memory_order_relaxed);
+        uint64_t frame;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            frame = generation_.load(std::memory_order_relaxed) + 1;
+            work_.store(frame << 32, std::memory_order_release);
+            generation_.store(frame, std::memory_order_release);
+        }
+        wake_.notify_all();
+
+        run_bands(frame);
+        while (bands_done_.load(std::memory_order_acquire) < band_count_) {
+            std::this_thread::yield();
+        }
+
+        histogram_.record(std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count());
+        return alpha_.data();
+    }
+
+    const LatencyHistogram& histogram() const { return histogram_; }
+    LatencyHistogram& histogram() { return histogram_; }
+    int threads() const { return (int)workers_.size() + 1; }
+
+    // Bind the calling thread to CPU 0, next to the pinned workers. The
+    // binding is permanent and outlives the keyer, so only call this from
+    // a thread dedicated to keying.
+    void pin_caller() const { pin_to_cpu(0); }
+
+private:
+    static void pin_to_cpu(int index) {
+#ifdef __linux__
+        unsigned cpus = std::thread::hardware_concurrency();
+        if (cpus == 0) return;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(index % cpus, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+        (void)index;
+#endif
+    }
+
+    // Claim bands of the given frame until none are left. The frame number
+    // lives in the top half of work_, so a worker that wakes late can never
+    // claim a band of a newer frame with stale state.
+    void run_bands(uint64_t frame) {
+        for (;;) {
+            uint64_t work = work_.load(std::memory_order_acquire);
+            if ((work >> 32) != frame || (int)(work & 0xffffffffu) >= band_count_) return;
+            if (!work_.compare_exchange_weak(work, work + 1, std::memory_order_acq_rel)) continue;
+
+            int band = (int)(work & 0xffffffffu);
+            Color3 key = params_.key();
+            int y0 = band * band_rows_;
+            int y1 = std::min(height_, y0 + band_rows_);
+            for (int y = y0; y < y1; y++) {
+                const size_t in = (size_t)y * stride_;
+                float* out = alpha_.data() + (size_t)y * width_;
+                for (int x = 0; x < width_; x++) {
+                    out[x] = key_pixel(params_, Color3(r_[in + x], g_[in + x], b_[in + x]), key);
+                }
+            }
+            bands_done_.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    void worker_loop() {
+        uint64_t seen = 0;
+        for (;;) {
+            // Spin briefly: at live frame rates the next frame arrives soon and
+            // a futex wake-up costs tens of microseconds
+            for (int spin = 0; spin < 2000 && generation_.load(std::memory_order_acquire) == seen; spin++) {
+                std::this_thread::yield();
+            }
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] {
+                    return stop_ || generation_.load(std::memory_order_acquire) != seen;
+                });
+                if (stop_) return;
+                seen = generation_.load(std::memory_order_acquire);
+            }
+            run_bands(seen);
+        }
+    }
+
+    int width_, height_;
+    int band_rows_, band_count_;
+    KeyerParams params_;
+    std::vector<float> alpha_;
+
+    // Current frame, published through generation_
+    const float* r_ = nullptr;
+    const float* g_ = nullptr;
+    const float* b_ = nullptr;
+    size_t stride_ = 0;
+
+    std::atomic<uint64_t> generation_;
+    std::atomic<uint64_t> work_;       // frame << 32 | next band
+    std::atomic<int> bands_done_;
+    bool stop_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<std::thread> workers_;
+    LatencyHistogram histogram_;
+};
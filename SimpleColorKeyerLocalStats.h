@@ -0,0 +1,226 @@
+// SimpleColorKeyerLocalStats.h - Local statistics from summed-area tables
+//
+// Two keyer modes look at a square window around every pixel:
+//
+//   - LocalStats: the standard deviation of RGB, which scales the
+//     adaptive tolerance
+//   - ScreenEstimate: the mean color of the pixels in the window that the
+//     global key already calls screen, keyed against as a local key color
+//
+// Both keep four summed-area tables over the frame (BoxSums), so any window
+// costs four lookups per table whatever its size.
+//
+// The tables are built once per frame, in parallel over bands of kBand rows.
+// Rows are fetched on the calling thread only - in Nuke, input0().get() is
+// for render threads, not the pool's workers - a group of bands at a time,
+// and the pool then sums each band from its own top edge. Finally the
+// bands' bottom rows are chained, in order, into one offset row per band.
+// A lookup adds the offset of the row's band, so the tables are written only
+// once. Sums are kept in double so that E[x^2] - E[x]^2 stays exact enough
+// for grain-level variances at 4K; that is 32 bytes per pixel.
+#pragma once
+
+#include "SimpleColorKeyerCore.h"
+#include "SimpleColorKeyerTasks.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Four summed-area tables over a frame, interleaved per pixel
+class BoxSums {
+public:
+    // Fill r, g and b (width floats each) with image row y
+    typedef std::function<void(int y, float* r, float* g, float* b)> RowSource;
+
+    static constexpr int kBand = 64;
+    static constexpr size_t kBytesPerPixel = 4 * sizeof(double);
+
+    BoxSums(int x0, int y0, int width, int height, RowSource source)
+        : x0_(x0), y0_(y0), width_(width), height_(height), source_(std::move(source)) {}
+
+    // Build the tables unless they are built already, summing
+    // terms(r, g, b, double t[4]) over the pixels on 'pool'. Safe to call
+    // from several threads; the others wait. The row source is only called
+    // from the thread that builds.
+    template <class Terms>
+    void build(TaskPool& pool, const Terms& terms) {
+        std::call_once(built_, [&] { build_tables(pool, terms); });
+    }
+
+    // Call fn(i, sums[4], pixels) for each pixel [x, r) of row y with the
+    // sums over the (2 radius + 1)^2 window around it, clipped to the
+    // frame. build() must have returned.
+    template <class F>
+    void windows(int y, int x, int r, int radius, const F& fn) const {
+        const int ry = std::min(std::max(y - y0_, 0), height_ - 1);
+        const int top = std::max(0, ry - radius), bottom = std::min(height_, ry + radius + 1);
+        const double* upper = &sat_[(size_t)top * stride()];
+        const double* lower = &sat_[(size_t)bottom * stride()];
+        const double* upper_offset = &offsets_[(size_t)band_of(top) * stride()];
+        const double* lower_offset = &offsets_[(size_t)band_of(bottom) * stride()];
+        for (int i = 0; i < r - x; i++) {
+            const int rx = std::min(std::max(x + i - x0_, 0), width_ - 1);
+            const int left = std::max(0, rx - radius), right = std::min(width_, rx + radius + 1);
+            double s[4];
+            for (int k = 0; k < 4; k++) {
+                const int rk = right * 4 + k, lk = left * 4 + k;
+                s[k] = (lower[rk] + lower_offset[rk]) - (lower[lk] + lower_offset[lk])
+                     - (upper[rk] + upper_offset[rk]) + (upper[lk] + upper_offset[lk]);
+            }
+            fn(i, s, (double)(bottom - top) * (right - left));
+        }
+    }
+
+private:
+    // Doubles per table row: a zero column, then width entries of 4 sums
+    size_t stride() const { return (size_t)(width_ + 1) * 4; }
+
+    // Band whose offset applies to table row i (row 0, all zero, uses band 0's)
+    static int band_of(int i) { return std::max(0, i - 1) / kBand; }
+
+    template <class Terms>
+    void build_tables(TaskPool& pool, const Terms& terms) {
+        // Row 0 is the zero row; row y + 1 sums image rows [0, y] once its
+        // band's offset is added. Every entry is written below, so the
+        // table is not cleared first.
+        sat_.reset(new double[(size_t)(height_ + 1) * stride()]);
+        std::fill(&sat_[0], &sat_[stride()], 0.0);
+        const int bands = (height_ + kBand - 1) / kBand;
+        const int group = pool.threads();
+        std::vector<float> rows((size_t)std::min(height_, group * kBand) * width_ * 3);
+
+        for (int g0 = 0; g0 < bands; g0 += group) {
+            const int g1 = std::min(bands, g0 + group);
+            const int top = g0 * kBand, bottom = std::min(height_, g1 * kBand);
+            // Fetch the group's rows here, as R, G and B per row
+            for (int ry = top; ry < bottom; ry++) {
+                float* R = &rows[(size_t)(ry - top) * width_ * 3];
+                source_(y0_ + ry, R, R + width_, R + 2 * width_);
+            }
+
+            // Sums within each band, from its own top edge
+            pool.parallel_for(g0, g1, 1, [&](int b0, int b1, int) {
+                for (int band = b0; band < b1; band++) {
+                    const int first = band * kBand, last = std::min(height_, first + kBand);
+                    for (int ry = first; ry < last; ry++) {
+                        const float* R = &rows[(size_t)(ry - top) * width_ * 3];
+                        const float* G = R + width_;
+                        const float* B = G + width_;
+                        double* out = &sat_[(size_t)(ry + 1) * stride()];
+                        const double* above = ry > first ? out - stride() : nullptr;
+                        double run[4] = { 0.0, 0.0, 0.0, 0.0 };
+                        std::fill(out, out + 4, 0.0);
+                        for (int rx = 0; rx < width_; rx++) {
+                            double t[4];
+                            terms(R[rx], G[rx], B[rx], t);
+                            double* o = out + (rx + 1) * 4;
+                            for (int k = 0; k < 4; k++) {
+                                run[k] += t[k];
+                                o[k] = run[k] + (above ? above[(rx + 1) * 4 + k] : 0.0);
+                            }
+                        }
+                    }
+                }
+            });
+        }
+
+        // Offset of each band: the full sum up to the row above it
+        offsets_.assign((size_t)bands * stride(), 0.0);
+        for (int band = 1; band < bands; band++) {
+            const double* prev = &offsets_[(size_t)(band - 1) * stride()];
+            const double* bottom = &sat_[(size_t)(band * kBand) * stride()];
+            double* o = &offsets_[(size_t)band * stride()];
+            for (size_t k = 0; k < stride(); k++) o[k] = prev[k] + bottom[k];
+        }
+    }
+
+    int x0_, y0_, width_, height_;
+    RowSource source_;
+    std::once_flag built_;
+    std::unique_ptr<double[]> sat_;
+    std::vector<double> offsets_;
+};
+
+// Local noise: sums of R, G, B and R^2 + G^2 + B^2
+class LocalStats {
+public:
+    LocalStats(int x0, int y0, int width, int height, BoxSums::RowSource source)
+        : sums_(x0, y0, width, height, std::move(source)) {}
+
+    void build(TaskPool& pool) {
+        sums_.build(pool, [](float r, float g, float b, double* t) {
+            t[0] = r;
+            t[1] = g;
+            t[2] = b;
+            t[3] = (double)r * r + (double)g * g + (double)b * b;
+        });
+    }
+
+    // Standard deviation of RGB (root mean of the three channel variances)
+    // over the window around each pixel [x, r) of row y
+    void sigma_row(int y, int x, int r, int radius, float* sigma) const {
+        sums_.windows(y, x, r, radius, [&](int i, const double* s, double n) {
+            const double mr = s[0] / n, mg = s[1] / n, mb = s[2] / n;
+            const double var = (s[3] / n - (mr * mr + mg * mg + mb * mb)) / 3.0;
+            sigma[i] = (float)std::sqrt(std::max(0.0, var));
+        });
+    }
+
+private:
+    BoxSums sums_;
+};
+
+// Tolerance for a pixel whose neighbourhood has standard deviation 'sigma':
+// 'tolerance' at the reference noise level, scaled in proportion to the
+// noise between a quarter and four times that
+inline float noise_scaled_tolerance(float tolerance, float sigma, float reference) {
+    return tolerance * std::min(4.0f, std::max(0.25f, sigma / std::max(1e-6f, reference)));
+}
+
+// Local screen color: a normalized box filter of the pixels the global key
+// calls screen (alpha of at least kScreenAlpha before invert), i.e. sums of
+// screen R, G, B and the screen pixel count
+class ScreenEstimate {
+public:
+    static constexpr float kScreenAlpha = 0.5f;
+
+    ScreenEstimate(int x0, int y0, int width, int height, const KeyerParams& params,
+                   BoxSums::RowSource source)
+        : params_(params), sums_(x0, y0, width, height, std::move(source)) {
+        params_.invert = false;
+    }
+
+    void build(TaskPool& pool) {
+        const Color3 key = params_.key();
+        sums_.build(pool, [&](float r, float g, float b, double* t) {
+            const double screen = key_pixel(params_, Color3(r, g, b), key) >= kScreenAlpha ? 1.0 : 0.0;
+            t[0] = screen * r;
+            t[1] = screen * g;
+            t[2] = screen * b;
+            t[3] = screen;
+        });
+    }
+
+    // Mean screen color in the window around each pixel [x, r) of row y, or
+    // the global key color where the window holds no screen
+    void local_key_row(int y, int x, int r, int radius, float* key_r, float* key_g, float* key_b) const {
+        sums_.windows(y, x, r, radius, [&](int i, const double* s, double) {
+            if (s[3] >= 0.5) {
+                key_r[i] = (float)(s[0] / s[3]);
+                key_g[i] = (float)(s[1] / s[3]);
+                key_b[i] = (float)(s[2] / s[3]);
+            } else {
+                key_r[i] = params_.key_color[0];
+                key_g[i] = params_.key_color[1];
+                key_b[i] = params_.key_color[2];
+            }
+        });
+    }
+
+private:
+    KeyerParams params_;
+    BoxSums sums_;
+};
@@ -0,0 +1,315 @@
+// SimpleColorKeyerMatte.h - Compact matte encoding and the .sckm file format
+//
+// Keyed mattes are mostly exactly 0 or exactly 1, with values in between
+// only along edges. Each row is stored as a sequence of runs:
+//
+//   varint (length << 2 | type)
+//     type 0: 'length' pixels of 0.0
+//     type 1: 'length' pixels of 1.0
+//     type 2: 'length' literal values follow, 2 bytes each (little-endian
+//             unorm16 or IEEE half, per the file's encoding)
+//
+// A .sckm file is a 24-byte header, a table of height + 1 row offsets
+// (uint64, from the start of the file) and the row data, so any row can be
+// located in O(1) and decoded on its own:
+//
+//   char     magic[4]  "SCKM"
+//   uint16   version   1
+//   uint16   encoding  0 = unorm16, 1 = half
+//   uint32   width
+//   uint32   height
+//   uint64   reserved
+//
+// decode_matte_row() expands runs with wide stores and converts literals
+// 8 at a time with SSE2 (and F16C for half, when compiled with it).
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SCK_MATTE_SSE2 1
+#endif
+#if defined(__F16C__)
+#include <immintrin.h>
+#define SCK_MATTE_F16C 1
+#endif
+
+enum MatteEncoding : uint16_t {
+    MATTE_UNORM16 = 0,          // exact to 1/65535, best for mattes in [0, 1]
+    MATTE_HALF = 1              // finer near 0, coarser near 1
+};
+
+static const char kMatteMagic[4] = { 'S', 'C', 'K', 'M' };
+static const uint16_t kMatteVersion = 1;
+static const size_t kMatteHeaderSize = 24;
+
+enum MatteRunType { RUN_ZERO = 0, RUN_ONE = 1, RUN_LITERAL = 2 };
+
+inline uint16_t float_to_half(float f) {
+    uint32_t x;
+    memcpy(&x, &f, 4);
+    uint32_t sign = (x >> 16) & 0x8000;
+    int32_t exp = (int32_t)((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mant = x & 0x7fffff;
+    if (((x >> 23) & 0xff) == 0xff) return (uint16_t)(sign | 0x7c00 | (mant ? 0x200 : 0));
+    if (exp >= 31) return (uint16_t)(sign | 0x7c00);
+    if (exp <= 0) {
+        if (exp < -10) return (uint16_t)sign;
+        mant |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exp);
+        uint32_t half = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t mid = 1u << (shift - 1);
+        if (rem > mid || (rem == mid && (half & 1))) half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = sign | ((uint32_t)exp << 10) | (mant >> 13);
+    uint32_t rem = mant & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) half++;
+    return (uint16_t)half;
+}
+
+inline float half_to_float(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t x;
+    if (exp == 0) {
+        if (mant == 0) {
+            x = sign;
+        } else {
+            // Subnormal: renormalize
+            exp = 127 - 15 + 1;
+            while (!(mant & 0x400)) { mant <<= 1; exp--; }
+            x = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+        }
+    } else if (exp == 31) {
+        x = sign | 0x7f800000 | (mant << 13);
+    } else {
+        x = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+    }
+    float f;
+    memcpy(&f, &x, 4);
+    return f;
+}
+
+inline void put_varint(std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+// Read a varint from [p, end). Returns false if it runs past 'end' or does
+// not fit in 32 bits (at most 5 bytes, the last holding 4 bits).
+inline bool get_varint(const uint8_t*& p, const uint8_t* end, uint32_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (p >= end) return false;
+        uint8_t b = *p++;
+        if (shift == 28 && b > 0x0f) return false;
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+// Upper bound on the encoded size of one row
+inline size_t matte_row_bound(int width) {
+    // Worst case: runs of 2 (one header byte) alternating with 1-pixel literals
+    return (size_t)width * 3 + 16;
+}
+
+// Append the encoding of one row of alpha to 'out'
+inline void encode_matte_row(const float* alpha, int width, MatteEncoding encoding,
+                             std::vector<uint8_t>& out) {
+    // A 0/1 run shorter than this is cheaper kept inside a literal run
+    const int kMinRun = 2;
+    int x = 0;
+    int literal_start = 0;
+
+    auto flush_literals = [&](int end) {
+        int n = end - literal_start;
+        if (n <= 0) return;
+        put_varint(out, ((uint32_t)n << 2) | RUN_LITERAL);
+        for (int i = literal_start; i < end; i++) {
+            uint16_t v;
+            if (encoding == MATTE_HALF) {
+                v = float_to_half(alpha[i]);
+            } else {
+                float a = std::max(0.0f, std::min(1.0f, alpha[i]));
+                v = (uint16_t)(a * 65535.0f + 0.5f);
+            }
+            out.push_back((uint8_t)(v & 0xff));
+            out.push_back((uint8_t)(v >> 8));
+        }
+    };
+
+    while (x < width) {
+        float a = alpha[x];
+        if (a == 0.0f || a == 1.0f) {
+            int end = x + 1;
+            while (end < width && alpha[end] == a) end++;
+            if (end - x >= kMinRun || (end == width && literal_start == x)) {
+                flush_literals(x);
+                put_varint(out, ((uint32_t)(end - x) << 2) | (a == 0.0f ? RUN_ZERO : RUN_ONE));
+                literal_start = end;
+            }
+            x = end;
+        } else {
+            x++;
+        }
+    }
+    flush_literals(width);
+}
+
+inline void fill_floats(float* out, int n, float value) {
+    int i = 0;
+#ifdef SCK_MATTE_SSE2
+    __m128 v = _mm_set1_ps(value);
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_ps(out + i, v);
+        _mm_storeu_ps(out + i + 4, v);
+    }
+#endif
+    for (; i < n; i++) out[i] = value;
+}
+
+inline void decode_literals(const uint8_t* p, int n, MatteEncoding encoding, float* out) {
+    int i = 0;
+    if (encoding == MATTE_UNORM16) {
+#ifdef SCK_MATTE_SSE2
+        const __m128 scale = _mm_set1_ps(1.0f / 65535.0f);
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 8 <= n; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 2));
+            __m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+            __m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero));
+            _mm_storeu_ps(out + i, _mm_mul_ps(lo, scale));
+            _mm_storeu_ps(out + i + 4, _mm_mul_ps(hi, scale));
+        }
+#endif
+        for (; i < n; i++) {
+            out[i] = (float)(p[i * 2] | (p[i * 2 + 1] << 8)) * (1.0f / 65535.0f);
+        }
+    } else {
+#ifdef SCK_MATTE_F16C
+        for (; i + 8 <= n; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 2));
+            _mm256_storeu_ps(out + i, _mm256_cvtph_ps(v));
+        }
+#endif
+        for (; i < n; i++) {
+            out[i] = half_to_float((uint16_t)(p[i * 2] | (p[i * 2 + 1] << 8)));
+        }
+    }
+}
+
+// Decode one encoded row into 'width' floats. Returns false on corrupt data.
+inline bool decode_matte_row(const uint8_t* data, size_t size, int width,
+                             MatteEncoding encoding, float* out) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    int x = 0;
+    while (x < width) {
+        uint32_t run;
+        if (!get_varint(p, end, run)) return false;
+        int n = (int)(run >> 2);
+        if (n <= 0 || n > width - x) return false;
+        switch (run & 3) {
+            case RUN_ZERO:
+                fill_floats(out + x, n, 0.0f);
+                break;
+            case RUN_ONE:
+                fill_floats(out + x, n, 1.0f);
+                break;
+            case RUN_LITERAL:
+                if ((size_t)(end - p) < (size_t)n * 2) return false;
+                decode_literals(p, n, encoding, out + x);
+                p += (size_t)n * 2;
+                break;
+            default:
+                return false;
+        }
+        x += n;
+    }
+    return true;
+}
+
+// Encode a whole frame of alpha into a complete .sckm file image
+inline void encode_matte_file(const float* alpha, int width, int height, MatteEncoding encoding,
+                              std::vector<uint8_t>& out) {
+    const size_t index_bytes = (size_t)(height + 1) * sizeof(uint64_t);
+    out.assign(kMatteHeaderSize + index_bytes, 0);
+    memcpy(out.data(), kMatteMagic, 4);
+    uint16_t version = kMatteVersion, enc = encoding;
+    uint32_t w = (uint32_t)width, h = (uint32_t)height;
+    memcpy(out.data() + 4, &version, 2);
+    memcpy(out.data() + 6, &enc, 2);
+    memcpy(out.data() + 8, &w, 4);
+    memcpy(out.data() + 12, &h, 4);
+
+    std::vector<uint64_t> index(height + 1);
+    for (int y = 0; y < height; y++) {
+        index[y] = out.size();
+        encode_matte_row(alpha + (size_t)y * width, width, encoding, out);
+    }
+    index[height] = out.size();
+    memcpy(out.data() + kMatteHeaderSize, index.data(), index_bytes);
+}
+
+// Random-access view of a .sckm file image held in memory (or mapped)
+class MatteReader {
+public:
+    // Returns false if the data is not a valid .sckm file
+    bool open(const uint8_t* data, size_t size) {
+        data_ = data;
+        size_ = size;
+        if (size < kMatteHeaderSize || memcmp(data, kMatteMagic, 4) != 0) return false;
+        uint16_t version, enc;
+        uint32_t w, h;
+        memcpy(&version, data + 4, 2);
+        memcpy(&enc, data + 6, 2);
+        memcpy(&w, data + 8, 4);
+        memcpy(&h, data + 12, 4);
+        if (version != kMatteVersion || enc > MATTE_HALF || w > (1u << 24) || h > (1u << 24)) return false;
+        if (size < kMatteHeaderSize + ((size_t)h + 1) * sizeof(uint64_t)) return false;
+        width_ = (int)w;
+        height_ = (int)h;
+        encoding_ = (MatteEncoding)enc;
+        index_ = data + kMatteHeaderSize;
+        return row_offset(height_) <= size_;
+    }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    MatteEncoding encoding() const { return encoding_; }
+
+    // Decode row y into 'width()' floats
+    bool read_row(int y, float* out) const {
+        if (y < 0 || y >= height_) return false;
+        uint64_t begin = row_offset(y), end = row_offset(y + 1);
+        if (begin > end || end > size_) return false;
+        return decode_matte_row(data_ + begin, (size_t)(end - begin), width_, encoding_, out);
+    }
+
+private:
+    uint64_t row_offset(int y) const {
+        uint64_t v;
+        memcpy(&v, index_ + (size_t)y * sizeof(uint64_t), sizeof(v));
+        return v;
+    }
+
+    const uint8_t* data_ = nullptr;
+    const uint8_t* index_ = nullptr;
+    size_t size_ = 0;
+    int width_ = 0, height_ = 0;
+    MatteEncoding encoding_ = MATTE_UNORM16;
+};
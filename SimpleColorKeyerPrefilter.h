@@ -0,0 +1,230 @@
+// SimpleColorKeyerPrefilter.h - Bilateral-grid chroma prefilter for the matte
+//
+// Grain on a screen scatters each pixel's chroma around the key color, and
+// the distance to the key - and so the alpha - scatters with it. ChromaGrid
+// smooths chroma (R-G, B-G, as in calculate_chroma_alpha) with a bilateral
+// grid before the pixel is keyed, keeping its luma:
+//
+//   - splat: every pixel adds its chroma, weighted, to the 16 grid cells
+//     around (x / cell, y / cell, du / range, dv / range), where (du, dv) is
+//     its chroma minus the key's; screen and foreground land in different
+//     range cells, and so do two foreground hues the same distance from the
+//     key, so edges against the screen and within the foreground are kept
+//   - blur: a [1 2 1] / 4 kernel along each grid axis
+//   - slice: a pixel reads back the interpolated average of those cells
+//
+// The range axes span kRangeCells cells centred on the key. Pixels whose
+// chroma lies outside - foreground well away from the key, which the
+// filter would leave near enough alone anyway - are neither splatted nor
+// filtered.
+//
+// Each step is linear in the number of pixels. The grid is built lazily,
+// one grid row at a time, by whichever thread first needs it: slicing
+// image row y needs blurred grid rows j and j + 1 (j = y / cell), which need
+// splatted rows j - 1 to j + 2, which read image rows up to padding() above
+// and below y over the full width. Rows are fetched through a callback, so
+// the Nuke node and the standalone tools share the code.
+#pragma once
+
+#include "SimpleColorKeyerCore.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class ChromaGrid {
+public:
+    // Fill r, g and b (width floats each) with image row y
+    typedef std::function<void(int y, float* r, float* g, float* b)> RowSource;
+
+    // Range cells along each chroma axis, centred on the key
+    static constexpr int kRangeCells = 10;
+
+    // Image region [x0, x0 + width) x [y0, y0 + height); 'cell' is the
+    // spatial grid spacing in pixels, 'range' the chroma spacing
+    ChromaGrid(int x0, int y0, int width, int height, int cell, float range, const Color3& key,
+               RowSource source)
+        : x0_(x0), y0_(y0), width_(width), height_(height), cell_(std::max(2, cell)),
+          range_(std::max(0.02f, range)), key_u_(key.r - key.g), key_v_(key.b - key.g),
+          source_(std::move(source)) {
+        gw_ = (width_ + cell_ - 1) / cell_ + 3;         // +1 for the splat, +1 pad per side
+        gr_ = kRangeCells + 3;
+        gh_ = (height_ + cell_ - 1) / cell_ + 2;
+        splat_once_.reset(new std::once_flag[gh_]);
+        blur_once_.reset(new std::once_flag[gh_]);
+    }
+
+    // Image rows beyond [y, y + 1) that filter_row(y) reads
+    static int padding(int cell) { return 3 * std::max(2, cell); }
+
+    // Bytes of grid storage once built
+    size_t bytes() const { return (size_t)gh_ * row_floats() * 2 * sizeof(float); }
+
+    // Prefiltered copy of image row y, columns [x, r), given the unfiltered
+    // row (indexed from x, like the outputs)
+    void filter_row(int y, int x, int r, const float* in_r, const float* in_g, const float* in_b,
+                    float* out_r, float* out_g, float* out_b) {
+        const int ry = std::min(std::max(y - y0_, 0), height_ - 1);
+        const float fy = (float)ry / cell_;
+        const int jy = (int)fy;
+        const float wy = fy - jy;
+        blurred_row(jy);
+        blurred_row(jy + 1);
+        const float* rows[2] = { &blur_[(size_t)jy * row_floats()], &blur_[(size_t)(jy + 1) * row_floats()] };
+
+        for (int i = 0; i < r - x; i++) {
+            const float R = in_r[i], G = in_g[i], B = in_b[i];
+            const float u = R - G, v = B - G;
+            float fu, fv;
+            if (!range_coords(u, v, fu, fv)) {
+                out_r[i] = R;
+                out_g[i] = G;
+                out_b[i] = B;
+                continue;
+            }
+            const int rx = std::min(std::max(x + i - x0_, 0), width_ - 1);
+            const float fx = (float)rx / cell_;
+            const int ix = (int)fx + 1;
+            const float wx = fx - (ix - 1);
+            const int iu = (int)fu + 1, iv = (int)fv + 1;
+            const float wu = fu - (iu - 1), wv = fv - (iv - 1);
+
+            float acc[3] = { 0.0f, 0.0f, 0.0f };
+            for (int dy = 0; dy < 2; dy++) {
+                const float w_y = dy ? wy : 1.0f - wy;
+                for (int dx = 0; dx < 2; dx++) {
+                    const float w_yx = w_y * (dx ? wx : 1.0f - wx);
+                    for (int du = 0; du < 2; du++) {
+                        const float w_yxu = w_yx * (du ? wu : 1.0f - wu);
+                        const float* c = rows[dy] + cell_offset(ix + dx, iu + du, iv);
+                        for (int k = 0; k < 3; k++) acc[k] += w_yxu * ((1.0f - wv) * c[k] + wv * c[3 + k]);
+                    }
+                }
+            }
+
+            float su = u, sv = v;
+            if (acc[2] > 1e-6f) {
+                su = acc[0] / acc[2];
+                sv = acc[1] / acc[2];
+            }
+            // Same luma, smoothed chroma: Y = G + 0.299 u + 0.114 v
+            const float luma = luma_of(Color3(R, G, B));
+            const float g = luma - 0.299f * su - 0.114f * sv;
+            out_r[i] = su + g;
+            out_g[i] = g;
+            out_b[i] = sv + g;
+        }
+    }
+
+private:
+    size_t row_floats() const { return (size_t)gw_ * gr_ * gr_ * 3; }
+
+    // Offset within a grid row of cell (ix, iu, iv), 3 floats per cell
+    size_t cell_offset(int ix, int iu, int iv) const { return (((size_t)ix * gr_ + iu) * gr_ + iv) * 3; }
+
+    // Range coordinates of a pixel's chroma, from 0 to kRangeCells; false
+    // outside the span of the range axes
+    bool range_coords(float u, float v, float& fu, float& fv) const {
+        fu = (u - key_u_) / range_ + 0.5f * kRangeCells;
+        fv = (v - key_v_) / range_ + 0.5f * kRangeCells;
+        return fu >= 0.0f && fu <= (float)kRangeCells && fv >= 0.0f && fv <= (float)kRangeCells;
+    }
+
+    void allocate() {
+        std::call_once(alloc_once_, [&] {
+            splat_.assign((size_t)gh_ * row_floats(), 0.0f);
+            blur_.assign((size_t)gh_ * row_floats(), 0.0f);
+        });
+    }
+
+    // Grid row j: splat the image rows within one cell of it, then blur
+    // along x, u and v
+    void splatted_row(int j) {
+        if (j < 0 || j >= gh_) return;
+        allocate();
+        std::call_once(splat_once_[j], [&] {
+            float* grid = &splat_[(size_t)j * row_floats()];
+            std::vector<float> rgb((size_t)width_ * 3);
+            float* R = rgb.data();
+            float* G = R + width_;
+            float* B = G + width_;
+            const int first = std::max(0, (j - 1) * cell_ + 1), last = std::min(height_, (j + 1) * cell_);
+            for (int ry = first; ry < last; ry++) {
+                const float wy = 1.0f - std::fabs((float)ry / cell_ - j);
+                source_(y0_ + ry, R, G, B);
+                for (int rx = 0; rx < width_; rx++) {
+                    const float u = R[rx] - G[rx], v = B[rx] - G[rx];
+                    float fu, fv;
+                    if (!range_coords(u, v, fu, fv)) continue;
+                    const float fx = (float)rx / cell_;
+                    const int ix = (int)fx + 1;
+                    const float wx = fx - (ix - 1);
+                    const int iu = (int)fu + 1, iv = (int)fv + 1;
+                    const float wu = fu - (iu - 1), wv = fv - (iv - 1);
+                    for (int dx = 0; dx < 2; dx++) {
+                        for (int du = 0; du < 2; du++) {
+                            for (int dv = 0; dv < 2; dv++) {
+                                const float w = wy * (dx ? wx : 1.0f - wx) * (du ? wu : 1.0f - wu)
+                                              * (dv ? wv : 1.0f - wv);
+                                float* c = grid + cell_offset(ix + dx, iu + du, iv + dv);
+                                c[0] += w * u;
+                                c[1] += w * v;
+                                c[2] += w;
+                            }
+                        }
+                    }
+                }
+            }
+            const size_t cells = (size_t)gr_ * gr_;
+            for (size_t k = 0; k < cells; k++) blur_axis(grid + k * 3, gw_, cells * 3);            // x
+            for (int ix = 0; ix < gw_; ix++) {
+                for (int iv = 0; iv < gr_; iv++) blur_axis(grid + cell_offset(ix, 0, iv), gr_, (size_t)gr_ * 3);    // u
+                for (int iu = 0; iu < gr_; iu++) blur_axis(grid + cell_offset(ix, iu, 0), gr_, 3);  // v
+            }
+        });
+    }
+
+    // Blurred grid row j: [1 2 1] / 4 over splatted rows j - 1, j, j + 1
+    void blurred_row(int j) {
+        if (j < 0 || j >= gh_) return;
+        allocate();
+        std::call_once(blur_once_[j], [&] {
+            splatted_row(j - 1);
+            splatted_row(j);
+            splatted_row(j + 1);
+            const size_t n = row_floats();
+            float* out = &blur_[(size_t)j * n];
+            const float* mid = &splat_[(size_t)j * n];
+            const float* above = j > 0 ? mid - n : nullptr;
+            const float* below = j + 1 < gh_ ? mid + n : nullptr;
+            for (size_t k = 0; k < n; k++) {
+                out[k] = 0.5f * mid[k] + 0.25f * ((above ? above[k] : 0.0f) + (below ? below[k] : 0.0f));
+            }
+        });
+    }
+
+    // In-place [1 2 1] / 4 along one axis: 'count' cells of 3 floats,
+    // 'stride' floats apart; cells outside count as empty
+    static void blur_axis(float* p, int count, size_t stride) {
+        float prev[3] = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < count; i++) {
+            float* c = p + i * stride;
+            const float* next = i + 1 < count ? c + stride : nullptr;
+            for (int k = 0; k < 3; k++) {
+                const float cur = c[k];
+                c[k] = 0.5f * cur + 0.25f * (prev[k] + (next ? next[k] : 0.0f));
+                prev[k] = cur;
+            }
+        }
+    }
+
+    int x0_, y0_, width_, height_, cell_;
+    float range_, key_u_, key_v_;
+    RowSource source_;
+    int gw_, gh_, gr_;
+    std::once_flag alloc_once_;
+    std::unique_ptr<std::once_flag[]> splat_once_, blur_once_;
+    std::vector<float> splat_, blur_;
+};
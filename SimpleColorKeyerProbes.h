@@ -0,0 +1,41 @@
+// SimpleColorKeyerProbes.h - USDT (SystemTap SDT) tracepoints
+//
+// The plugin marks entry and exit of engine(), _request() and _validate()
+// with static probes under the provider "simplecolorkeyer", so production
+// renders can be profiled with bpftrace or perf without a special build
+// (see tools/bpftrace/). An unattached probe is a single nop in the code
+// and a note in the ELF file; arguments are values already in registers.
+//
+// Probes are compiled in on Linux when <sys/sdt.h> is available (the
+// systemtap-sdt-dev / systemtap-sdt-devel package) and left out otherwise,
+// or when SCK_NO_PROBES is defined.
+#pragma once
+
+#if defined(__linux__) && !defined(SCK_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SCK_HAVE_PROBES 1
+#endif
+#endif
+
+#ifdef SCK_HAVE_PROBES
+#define SCK_PROBE2(name, a, b) DTRACE_PROBE2(simplecolorkeyer, name, a, b)
+#define SCK_PROBE4(name, a, b, c, d) DTRACE_PROBE4(simplecolorkeyer, name, a, b, c, d)
+#define SCK_PROBE5(name, a, b, c, d, e) DTRACE_PROBE5(simplecolorkeyer, name, a, b, c, d, e)
+#define SCK_PROBE6(name, a, b, c, d, e, f) DTRACE_PROBE6(simplecolorkeyer, name, a, b, c, d, e, f)
+#else
+#define SCK_PROBE2(name, a, b) do {} while (0)
+#define SCK_PROBE4(name, a, b, c, d) do {} while (0)
+#define SCK_PROBE5(name, a, b, c, d, e) do {} while (0)
+#define SCK_PROBE6(name, a, b, c, d, e, f) do {} while (0)
+#endif
+
+// Probe reference (arguments in order):
+//
+//   validate_entry   for_real, method
+//   validate_exit    for_real, method
+//   request_entry    x, y, r, t, channel mask, count
+//   request_exit     x, y, r, t, channel mask, count
+//   engine_entry     y, x, r, channel mask, method
+//   engine_exit      y, x, r, channel mask, method, served from matte cache (0/1)
+//   arena_grow       new block size in bytes, blocks allocated so far (all threads)
@@ -0,0 +1,339 @@
+// SimpleColorKeyerShm.h - Shared-memory protocol for the local key server
+//
+// SimpleColorKeyerServer owns a POSIX shared memory segment holding a
+// fixed number of frame slots. A client claims a free slot, renders its
+// planar float RGB frame straight into the slot, fills in the parameter
+// block and rings the server's doorbell. The server keys the slot in place
+// and the client reads the alpha from the same mapping - no frame is ever
+// copied between processes. Signaling uses process-shared futexes on the
+// slot state and doorbell words. Linux only.
+#pragma once
+
+#include "SimpleColorKeyerCore.h"
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <csignal>
+#include <cstdio>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const char* const kShmKeyerDefaultName = "/simplecolorkeyer";
+static const uint32_t kShmKeyerMagic = 0x4b435353;   // "SSCK"
+static const uint32_t kShmKeyerVersion = 2;
+// owner_pid of a slot its client gave up on while the server was keying it;
+// the server frees it once keyed
+static const int32_t kShmSlotAbandoned = -1;
+
+enum ShmSlotState : uint32_t {
+    SLOT_FREE = 0,      // available to any client
+    SLOT_CLAIMED,       // owned by a client that is filling it in
+    SLOT_REQUEST,       // submitted, waiting for the server
+    SLOT_WORKING,       // being keyed by a server thread
+    SLOT_DONE           // alpha ready, still owned by the client
+};
+
+// Fixed-layout copy of KeyerParams (no bool, no padding surprises)
+struct ShmKeyParams {
+    float key_color[3];
+    float variance;
+    float range_red, range_magenta, range_green, range_yellow, range_blue, range_cyan;
+    float gain;
+    int32_t invert;
+    int32_t keying_method;
+
+    void from(const KeyerParams& p) {
+        memcpy(key_color, p.key_color, sizeof(key_color));
+        variance = p.variance;
+        range_red = p.range_red; range_magenta = p.range_magenta;
+        range_green = p.range_green; range_yellow = p.range_yellow;
+        range_blue = p.range_blue; range_cyan = p.range_cyan;
+        gain = p.gain;
+        invert = p.invert ? 1 : 0;
+        keying_method = p.keying_method;
+    }
+
+    KeyerParams to() const {
+        KeyerParams p;
+        memcpy(p.key_color, key_color, sizeof(key_color));
+        p.variance = variance;
+        p.range_red = range_red; p.range_magenta = range_magenta;
+        p.range_green = range_green; p.range_yellow = range_yellow;
+        p.range_blue = range_blue; p.range_cyan = range_cyan;
+        p.gain = gain;
+        p.invert = invert != 0;
+        p.keying_method = keying_method;
+        return p;
+    }
+};
+
+struct alignas(64) ShmSlot {
+    std::atomic<uint32_t> state;
+    int32_t owner_pid;          // client holding the slot, for reaping
+    uint32_t width, height;
+    int32_t error;              // set by the server with DONE: 0, or EINVAL if rejected
+    ShmKeyParams params;
+    // Followed by the r, g, b and alpha planes, each plane_bytes long
+};
+
+struct alignas(64) ShmHeader {
+    uint32_t magic, version;
+    uint32_t slot_count;
+    uint32_t max_width, max_height;
+    std::atomic<uint32_t> doorbell;     // bumped on every submit
+    std::atomic<uint32_t> server_alive;
+    int32_t server_pid;                 // server process, for detecting a live owner
+    uint64_t plane_bytes;               // one float plane, 64-byte aligned
+    uint64_t slot_stride;               // ShmSlot plus four planes
+    uint64_t total_bytes;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared atomics must be lock-free");
+
+inline long shm_futex(std::atomic<uint32_t>* word, int op, uint32_t value, const timespec* timeout = nullptr) {
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), op, value, timeout, nullptr, 0);
+}
+
+inline void shm_futex_wake(std::atomic<uint32_t>* word, int count = INT_MAX) {
+    shm_futex(word, FUTEX_WAKE, (uint32_t)count);
+}
+
+// Sleep while *word == expected (or until timeout_ms, if >= 0)
+inline void shm_futex_wait(std::atomic<uint32_t>* word, uint32_t expected, int timeout_ms = -1) {
+    timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    shm_futex(word, FUTEX_WAIT, expected, timeout_ms >= 0 ? &ts : nullptr);
+}
+
+inline uint64_t shm_plane_bytes(uint32_t max_width, uint32_t max_height) {
+    uint64_t bytes = (uint64_t)max_width * max_height * sizeof(float);
+    return (bytes + 63) & ~(uint64_t)63;
+}
+
+// False once 'pid' has exited, including while it is an unreaped zombie
+inline bool shm_process_alive(pid_t pid) {
+    if (pid <= 0 || (kill(pid, 0) != 0 && errno == ESRCH)) return false;
+    char path[32], line[512];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE* f = fopen(path, "r");
+    if (!f) return true;
+    bool alive = true;
+    if (fgets(line, sizeof(line), f)) {
+        // "pid (comm) state ...", where comm may itself contain ')'
+        const char* paren = strrchr(line, ')');
+        alive = !(paren && paren[1] == ' ' && (paren[2] == 'Z' || paren[2] == 'X'));
+    }
+    fclose(f);
+    return alive;
+}
+
+// Pid of the server currently serving 'name', or 0 if the name is free or
+// its segment was left behind by a server that exited without cleaning up.
+// A live server of another protocol version counts as running.
+inline pid_t shm_running_server(const char* name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmHeader)) {
+        close(fd);
+        return 0;
+    }
+    void* base = mmap(nullptr, sizeof(ShmHeader), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return 0;
+
+    const ShmHeader* h = static_cast<const ShmHeader*>(base);
+    pid_t pid = 0;
+    if (h->magic == kShmKeyerMagic && h->server_alive.load(std::memory_order_acquire)) {
+        if (h->version != kShmKeyerVersion) {
+            pid = -1;
+        } else if (shm_process_alive(h->server_pid)) {
+            pid = h->server_pid;
+        }
+    }
+    munmap(base, sizeof(ShmHeader));
+    return pid;
+}
+
+// Slot and plane addressing shared by the server and clients
+struct ShmKeyerLayout {
+    ShmHeader* header = nullptr;
+
+    ShmSlot* slot(uint32_t i) const {
+        return reinterpret_cast<ShmSlot*>(reinterpret_cast<char*>(header) + sizeof(ShmHeader) +
+                                          i * header->slot_stride);
+    }
+    // plane 0..2 = r, g, b; plane 3 = alpha. Rows are 'width' floats apart.
+    float* plane(uint32_t i, int p) const {
+        return reinterpret_cast<float*>(reinterpret_cast<char*>(slot(i)) + sizeof(ShmSlot) +
+                                        p * header->plane_bytes);
+    }
+};
+
+class ShmKeyerClient {
+public:
+    struct Request {
+        uint32_t slot;
+        int width, height;
+        float* r;
+        float* g;
+        float* b;
+        float* alpha;
+    };
+
+    ~ShmKeyerClient() { disconnect(); }
+
+    // Map an existing server segment. Returns false (with errno set) on failure.
+    bool connect(const char* name = kShmKeyerDefaultName) {
+        int fd = shm_open(name, O_RDWR, 0);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmHeader)) {
+            close(fd);
+            errno = EINVAL;
+            return false;
+        }
+        void* base = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) return false;
+
+        layout_.header = static_cast<ShmHeader*>(base);
+        size_ = st.st_size;
+        if (layout_.header->magic != kShmKeyerMagic || layout_.header->version != kShmKeyerVersion) {
+            disconnect();
+            errno = EPROTO;
+            return false;
+        }
+        return true;
+    }
+
+    void disconnect() {
+        if (layout_.header) munmap(layout_.header, size_);
+        layout_.header = nullptr;
+    }
+
+    // False once the server has shut down, or has died without saying so
+    bool server_alive() const {
+        return layout_.header && layout_.header->server_alive.load(std::memory_order_acquire) &&
+               shm_process_alive(layout_.header->server_pid);
+    }
+
+    // Claim a free slot for a width x height frame, waiting if all are busy.
+    // Returns false if the frame is larger than the server's slots.
+    bool acquire(int width, int height, Request& req) {
+        ShmHeader* h = layout_.header;
+        if (!h || width <= 0 || height <= 0 ||
+            (uint64_t)width * height > (uint64_t)h->max_width * h->max_height) {
+            errno = EINVAL;
+            return false;
+        }
+        for (uint32_t attempt = 0;; attempt++) {
+            for (uint32_t i = 0; i < h->slot_count; i++) {
+                ShmSlot* s = layout_.slot(i);
+                uint32_t expected = SLOT_FREE;
+                if (s->state.compare_exchange_strong(expected, SLOT_CLAIMED, std::memory_order_acquire)) {
+                    s->owner_pid = (int32_t)getpid();
+                    s->width = (uint32_t)width;
+                    s->height = (uint32_t)height;
+                    req.slot = i;
+                    req.width = width;
+                    req.height = height;
+                    req.r = layout_.plane(i, 0);
+                    req.g = layout_.plane(i, 1);
+                    req.b = layout_.plane(i, 2);
+                    req.alpha = layout_.plane(i, 3);
+                    return true;
+                }
+            }
+            if (!server_alive()) {
+                errno = ECONNREFUSED;
+                return false;
+            }
+            // All slots busy - back off briefly
+            usleep(attempt < 100 ? 50 : 1000);
+        }
+    }
+
+    // Hand a filled-in slot to the server
+    void submit(const Request& req, const KeyerParams& params) {
+        ShmSlot* s = layout_.slot(req.slot);
+        s->params.from(params);
+        s->state.store(SLOT_REQUEST, std::memory_order_release);
+        layout_.header->doorbell.fetch_add(1, std::memory_order_release);
+        shm_futex_wake(&layout_.header->doorbell, 1);
+    }
+
+    // Block until the server has written req.alpha. Returns false if the
+    // server went away, rejected the frame (errno EINVAL) or timeout_ms (if
+    // >= 0) elapsed.
+    bool wait(const Request& req, int timeout_ms = -1) {
+        ShmSlot* s = layout_.slot(req.slot);
+        timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (;;) {
+            uint32_t state = s->state.load(std::memory_order_acquire);
+            if (state == SLOT_DONE) {
+                if (s->error == 0) return true;
+                errno = s->error;
+                return false;
+            }
+            if (!server_alive()) return false;
+            if (timeout_ms >= 0) {
+                timespec now;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                long elapsed = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+                if (elapsed >= timeout_ms) return false;
+            }
+            // Wake up periodically to notice a dead server
+            shm_futex_wait(&s->state, state, 100);
+        }
+    }
+
+    // Give the slot back. A slot the server is still keying (after a wait()
+    // timeout) is left to the server, which frees it when done; returns
+    // false in that case.
+    bool release(const Request& req) {
+        ShmSlot* s = layout_.slot(req.slot);
+        uint32_t state = s->state.load(std::memory_order_acquire);
+        for (;;) {
+            if (state == SLOT_FREE) return false;     // already reclaimed
+            if (state == SLOT_WORKING) {
+                s->owner_pid = kShmSlotAbandoned;
+                return false;
+            }
+            // CLAIMED and DONE only change hands here; REQUEST may still be
+            // picked up by the server, which the CAS detects
+            s->owner_pid = 0;
+            if (s->state.compare_exchange_weak(state, SLOT_FREE, std::memory_order_acq_rel)) return true;
+        }
+    }
+
+    // Convenience: acquire, copy in, key, copy out, release
+    bool key_frame(const float* r, const float* g, const float* b, int width, int height,
+                   const KeyerParams& params, float* alpha) {
+        Request req;
+        if (!acquire(width, height, req)) return false;
+        size_t bytes = (size_t)width * height * sizeof(float);
+        memcpy(req.r, r, bytes);
+        memcpy(req.g, g, bytes);
+        memcpy(req.b, b, bytes);
+        submit(req, params);
+        bool ok = wait(req);
+        if (ok) memcpy(alpha, req.alpha, bytes);
+        release(req);
+        return ok;
+    }
+
+private:
+    ShmKeyerLayout layout_;
+    size_t size_ = 0;
+};
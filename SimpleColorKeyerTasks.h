@@ -0,0 +1,208 @@
+// SimpleColorKeyerTasks.h - Work-stealing parallel_for over row ranges
+//
+// Whole-frame work (batch keying, clean plates, incremental keying) splits
+// a frame into chunks of rows. Chunks do not cost the same: rows through
+// edges and hair take longer to key than flat screen, so a static split
+// leaves threads idle while one finishes its band. TaskPool keeps a set of
+// persistent workers, each with its own deque of chunks:
+//
+//   - parallel_for() deals the chunks out in contiguous blocks, one block
+//     per worker, so each worker walks neighbouring rows
+//   - a worker takes chunks from the front of its own deque
+//   - a worker whose deque is empty steals the back half of another
+//     worker's deque, and carries on from there
+//
+// A deque is a range of chunk indices packed into one 64-bit atomic, so
+// pops and steals are a single compare-and-swap and no chunk list is
+// allocated. The calling thread takes part as worker 0. Calls from inside a
+// running parallel_for run inline on the calling worker.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskPool {
+public:
+    // 'threads' workers in total, including the thread calling parallel_for
+    explicit TaskPool(int threads) : slots_(std::max(1, threads)) {
+        for (int i = 1; i < (int)slots_.size(); i++) workers_.emplace_back([this, i] { worker_loop(i); });
+    }
+
+    ~TaskPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& t : workers_) t.join();
+    }
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    int threads() const { return (int)slots_.size(); }
+
+    // Call fn(begin, end, worker) over [begin, end) in chunks of 'grain'
+    // items and return when all are done. 'worker' is in [0, threads()) and
+    // unique among concurrently running calls, for per-worker scratch.
+    template <class F>
+    void parallel_for(int begin, int end, int grain, const F& fn) {
+        if (end <= begin) return;
+        grain = std::max(1, grain);
+        if (current_pool() == this) {
+            fn(begin, end, current_worker());
+            return;
+        }
+        std::lock_guard<std::mutex> serial(run_mutex_);
+        const int chunks = (int)(((int64_t)end - begin + grain - 1) / grain);
+        if (chunks == 1 || slots_.size() == 1) {
+            WorkerScope scope(this, 0);
+            fn(begin, end, 0);
+            return;
+        }
+
+        job_.begin = begin;
+        job_.end = end;
+        job_.grain = grain;
+        job_.context = &fn;
+        job_.run = [](const void* context, int b, int e, int worker) {
+            (*static_cast<const F*>(context))(b, e, worker);
+        };
+        const int n = (int)slots_.size();
+        for (int i = 0; i < n; i++) {
+            slots_[i].range.store(pack((int64_t)chunks * i / n, (int64_t)chunks * (i + 1) / n),
+                                  std::memory_order_relaxed);
+        }
+        busy_.store(n - 1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            generation_++;
+        }
+        wake_.notify_all();
+
+        run_chunks(0);
+
+        // Wait for every worker to leave the job, not just for the chunks:
+        // a late thief must not touch the deques of the next call
+        if (busy_.load(std::memory_order_acquire) != 0) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_.wait(lock, [this] { return busy_.load(std::memory_order_acquire) == 0; });
+        }
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> range{0};     // chunk indices [low 32 bits, high 32 bits)
+    };
+
+    struct Job {
+        int begin = 0, end = 0, grain = 1;
+        const void* context = nullptr;
+        void (*run)(const void*, int, int, int) = nullptr;
+    };
+
+    static uint64_t pack(int64_t lo, int64_t hi) { return (uint64_t)hi << 32 | (uint32_t)lo; }
+    static int lo_of(uint64_t r) { return (int)(uint32_t)r; }
+    static int hi_of(uint64_t r) { return (int)(r >> 32); }
+
+    static TaskPool*& current_pool() {
+        static thread_local TaskPool* pool = nullptr;
+        return pool;
+    }
+    static int& current_worker() {
+        static thread_local int worker = 0;
+        return worker;
+    }
+
+    // Marks the calling thread as worker 'self' of 'pool' while in scope, so
+    // nested parallel_for calls run inline
+    struct WorkerScope {
+        TaskPool* outer_pool;
+        int outer_worker;
+        WorkerScope(TaskPool* pool, int self) : outer_pool(current_pool()), outer_worker(current_worker()) {
+            current_pool() = pool;
+            current_worker() = self;
+        }
+        ~WorkerScope() {
+            current_pool() = outer_pool;
+            current_worker() = outer_worker;
+        }
+    };
+
+    // Take the next chunk from the front of worker 'self's deque
+    bool pop(int self, int& chunk) {
+        std::atomic<uint64_t>& range = slots_[self].range;
+        uint64_t r = range.load(std::memory_order_acquire);
+        while (lo_of(r) < hi_of(r)) {
+            if (range.compare_exchange_weak(r, pack(lo_of(r) + 1, hi_of(r)), std::memory_order_acq_rel)) {
+                chunk = lo_of(r);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Move the back half of some other worker's deque into 'self's (empty)
+    // deque. Returns false when every deque is empty.
+    bool steal(int self) {
+        const int n = (int)slots_.size();
+        for (int k = 1; k < n; k++) {
+            std::atomic<uint64_t>& victim = slots_[(self + k) % n].range;
+            uint64_t r = victim.load(std::memory_order_acquire);
+            while (lo_of(r) < hi_of(r)) {
+                const int take = (hi_of(r) - lo_of(r) + 1) / 2;
+                const int split = hi_of(r) - take;
+                if (victim.compare_exchange_weak(r, pack(lo_of(r), split), std::memory_order_acq_rel)) {
+                    // Only this thread writes an empty deque, so a plain store will do
+                    slots_[self].range.store(pack(split, split + take), std::memory_order_release);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void run_chunks(int self) {
+        WorkerScope scope(this, self);
+        int chunk;
+        for (;;) {
+            while (pop(self, chunk)) {
+                const int b = job_.begin + chunk * job_.grain;
+                job_.run(job_.context, b, std::min(job_.end, b + job_.grain), self);
+            }
+            if (!steal(self)) break;
+        }
+    }
+
+    void worker_loop(int self) {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+                if (stop_) return;
+                seen = generation_;
+            }
+            run_chunks(self);
+            if (busy_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_.notify_one();
+            }
+        }
+    }
+
+    std::vector<Slot> slots_;
+    std::vector<std::thread> workers_;
+    Job job_;
+    std::atomic<int> busy_{0};          // workers still inside the current job
+    std::mutex run_mutex_;              // one parallel_for at a time
+    std::mutex mutex_;
+    std::condition_variable wake_, done_;
+    uint64_t generation_ = 0;
+    bool stop_ = false;
+};
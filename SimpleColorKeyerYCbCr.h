@@ -0,0 +1,201 @@
+// SimpleColorKeyerYCbCr.h - Key 10-bit 4:2:2 frames (v210 / P210) directly
+//
+// The RGB keying math only ever looks at linear combinations of R, G and B,
+// so every term can be rewritten in YCbCr:
+//
+//   R = Y + rcr*Cr          R-G = (gcb)*Cb + (rcr+gcr)*Cr
+//   G = Y - gcb*Cb - gcr*Cr B-G = (bcb+gcb)*Cb + (gcr)*Cr
+//   B = Y + bcb*Cb          luma = Y + lcb*Cb + lcr*Cr
+//
+// R-G and B-G do not depend on Y, so the chroma key is evaluated once per
+// chroma sample (every second pixel) and shared by both luma samples. The
+// per-channel chroma offsets are also computed once per pair; luma-dependent
+// terms (distance, expansions, luma weight) add Y per pixel at full
+// resolution. No float RGB frame is ever materialized.
+//
+// Tolerance: for every method the result matches key_row() run on the same
+// frame decoded to float RGB with co-sited (nearest) chroma upsampling and
+// the same matrix (decode_v210_row / decode_p210_row), to within
+// alpha_tolerance(). The difference is float rounding from evaluating R-G /
+// B-G directly instead of subtracting reconstructed channels, a few ulp of
+// a unit-range color that the keying divides by Tolerance and multiplies by
+// Gain, so the bound is relative to both.
+// SimpleColorKeyerStream --check measures it on real frames.
+#pragma once
+
+#include "SimpleColorKeyerCore.h"
+#include <cstdint>
+
+enum YCbCrMatrix {
+    YCBCR_REC709 = 0,
+    YCBCR_REC601 = 1
+};
+
+enum YCbCrRange {
+    YCBCR_VIDEO_RANGE = 0,      // Y 64-940, C 64-960 (10-bit)
+    YCBCR_FULL_RANGE = 1        // Y 0-1023, C 1-1023 (10-bit)
+};
+
+class YCbCrKeyer {
+public:
+    // Color rounding error the alpha bound is built from
+    static constexpr float kTolerance = 1e-6f;
+
+    YCbCrKeyer(const KeyerParams& params, YCbCrMatrix matrix = YCBCR_REC709,
+               YCbCrRange range = YCBCR_VIDEO_RANGE)
+        : params_(params), key_(params.key()) {
+        // Kr/Kb luma coefficients of the source matrix
+        float kr = (matrix == YCBCR_REC601) ? 0.299f : 0.2126f;
+        float kb = (matrix == YCBCR_REC601) ? 0.114f : 0.0722f;
+        float kg = 1.0f - kr - kb;
+
+        rcr_ = 2.0f * (1.0f - kr);
+        bcb_ = 2.0f * (1.0f - kb);
+        gcb_ = bcb_ * kb / kg;
+        gcr_ = rcr_ * kr / kg;
+
+        // luma_of() uses Rec.601 weights on RGB regardless of the source matrix
+        lcb_ = -0.587f * gcb_ + 0.114f * bcb_;
+        lcr_ = 0.299f * rcr_ - 0.587f * gcr_;
+
+        if (range == YCBCR_FULL_RANGE) {
+            y_scale_ = 1.0f / 1023.0f;
+            y_offset_ = 0.0f;
+            c_scale_ = 1.0f / 1022.0f;
+        } else {
+            y_scale_ = 1.0f / 876.0f;
+            y_offset_ = 64.0f;
+            c_scale_ = 1.0f / 896.0f;
+        }
+
+        key_u_ = key_.r - key_.g;
+        key_v_ = key_.b - key_.g;
+        key_luma_ = luma_of(key_);
+    }
+
+    // Key one v210 row. 'words' points to the start of the row, which holds
+    // ceil(width / 6) groups of four little-endian 32-bit words.
+    void key_v210_row(const uint32_t* words, int width, float* alpha) const {
+        uint16_t y[6], cb[3], cr[3];
+        for (int x = 0; x < width; x += 6, words += 4) {
+            unpack_v210(words, y, cb, cr);
+            int n = std::min(6, width - x);
+            for (int i = 0; i < n; i += 2) {
+                key_pair(y[i], y[i + 1], cb[i / 2], cr[i / 2], alpha + x + i, n - i);
+            }
+        }
+    }
+
+    // Key one P210 row: a full-resolution 16-bit luma plane and a
+    // half-resolution interleaved CbCr plane, 10 bits stored in the high bits.
+    void key_p210_row(const uint16_t* y, const uint16_t* cbcr, int width, float* alpha) const {
+        for (int x = 0; x < width; x += 2) {
+            uint16_t y0 = y[x] >> 6;
+            uint16_t y1 = (x + 1 < width) ? (y[x + 1] >> 6) : y0;
+            key_pair(y0, y1, cbcr[x] >> 6, cbcr[x + 1] >> 6, alpha + x, width - x);
+        }
+    }
+
+    // Decode one v210 row to float RGB, each chroma sample shared by its two
+    // pixels: the frame key_v210_row() keys, as key_row() would see it
+    void decode_v210_row(const uint32_t* words, int width, float* r, float* g, float* b) const {
+        uint16_t y[6], cb[3], cr[3];
+        for (int x = 0; x < width; x += 6, words += 4) {
+            unpack_v210(words, y, cb, cr);
+            for (int i = 0; i < std::min(6, width - x); i++) {
+                const Color3 c = to_rgb(y[i], cb[i / 2], cr[i / 2]);
+                r[x + i] = c.r;
+                g[x + i] = c.g;
+                b[x + i] = c.b;
+            }
+        }
+    }
+
+    // Decode one P210 row to float RGB, as decode_v210_row()
+    void decode_p210_row(const uint16_t* y, const uint16_t* cbcr, int width, float* r, float* g,
+                         float* b) const {
+        for (int x = 0; x < width; x++) {
+            const Color3 c = to_rgb(y[x] >> 6, cbcr[x & ~1] >> 6, cbcr[(x & ~1) + 1] >> 6);
+            r[x] = c.r;
+            g[x] = c.g;
+            b[x] = c.b;
+        }
+    }
+
+    // Largest expected |alpha - key_row() alpha| for this keyer's parameters
+    float alpha_tolerance() const {
+        return kTolerance * std::max(1.0f, params_.gain) * (1.0f + 1.0f / params_.variance);
+    }
+
+    // Decode a single sample to RGB with the same matrix (reference/debugging)
+    Color3 to_rgb(uint16_t y_code, uint16_t cb_code, uint16_t cr_code) const {
+        float Y = (y_code - y_offset_) * y_scale_;
+        float cb = (cb_code - 512.0f) * c_scale_;
+        float cr = (cr_code - 512.0f) * c_scale_;
+        return Color3(Y + rcr_ * cr, Y - gcb_ * cb - gcr_ * cr, Y + bcb_ * cb);
+    }
+
+private:
+    // One v210 group of four words: six luma and three chroma pairs
+    static void unpack_v210(const uint32_t* words, uint16_t y[6], uint16_t cb[3], uint16_t cr[3]) {
+        // Cb0 Y0 Cr0 | Y1 Cb1 Y2 | Cr1 Y3 Cb2 | Y4 Cr2 Y5
+        cb[0] = words[0] & 0x3ff; y[0] = (words[0] >> 10) & 0x3ff; cr[0] = (words[0] >> 20) & 0x3ff;
+        y[1] = words[1] & 0x3ff; cb[1] = (words[1] >> 10) & 0x3ff; y[2] = (words[1] >> 20) & 0x3ff;
+        cr[1] = words[2] & 0x3ff; y[3] = (words[2] >> 10) & 0x3ff; cb[2] = (words[2] >> 20) & 0x3ff;
+        y[4] = words[3] & 0x3ff; cr[2] = (words[3] >> 10) & 0x3ff; y[5] = (words[3] >> 20) & 0x3ff;
+    }
+
+    // Key the two luma samples that share one chroma sample. 'remaining' is
+    // the number of pixels left in the row (the last pair may be a single).
+    void key_pair(uint16_t y0_code, uint16_t y1_code, uint16_t cb_code, uint16_t cr_code,
+                  float* out, int remaining) const {
+        // Chroma-resolution terms
+        float cb = (cb_code - 512.0f) * c_scale_;
+        float cr = (cr_code - 512.0f) * c_scale_;
+        float dr = rcr_ * cr;
+        float dg = -gcb_ * cb - gcr_ * cr;
+        float db = bcb_ * cb;
+
+        float chroma_alpha = 0.0f;
+        if (params_.keying_method == KEY_CHROMA || params_.keying_method == KEY_ADAPTIVE) {
+            chroma_alpha = chroma_alpha_uv(params_, dr - dg, db - dg, key_u_, key_v_);
+        }
+
+        int n = remaining < 2 ? remaining : 2;
+        uint16_t codes[2] = { y0_code, y1_code };
+        for (int i = 0; i < n; i++) {
+            float alpha;
+            if (params_.keying_method == KEY_CHROMA) {
+                alpha = chroma_alpha;
+            } else {
+                // Luma-resolution terms
+                float Y = (codes[i] - y_offset_) * y_scale_;
+                Color3 pixel(Y + dr, Y + dg, Y + db);
+                float distance_alpha = calculate_distance_alpha(params_, pixel, key_);
+                switch (params_.keying_method) {
+                    case KEY_LUMA_WEIGHTED:
+                        alpha = distance_alpha * luma_weight(Y + lcb_ * cb + lcr_ * cr, key_luma_);
+                        break;
+                    case KEY_ADAPTIVE:
+                        alpha = adaptive_blend(distance_alpha, chroma_alpha, key_);
+                        break;
+                    default:
+                        alpha = distance_alpha;
+                        break;
+                }
+            }
+            out[i] = finish_alpha(params_, alpha);
+        }
+    }
+
+    KeyerParams params_;
+    Color3 key_;
+    float key_u_, key_v_, key_luma_;
+
+    // Y'CbCr -> R'G'B' coefficients
+    float rcr_, gcb_, gcr_, bcb_;
+    // luma_of() expressed on Cb/Cr
+    float lcb_, lcr_;
+    // Code value normalization
+    float y_scale_, y_offset_, c_scale_;
+};
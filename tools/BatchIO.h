@@ -0,0 +1,298 @@
+// BatchIO.h - Asynchronous file I/O backends for batch keying
+//
+// A backend takes positional read/write requests and hands them back as
+// they complete, so the batch driver can keep a queue of frame reads and
+// matte writes in flight while worker threads key:
+//
+//   UringBackend       io_uring with the frame buffers registered up front
+//                      (READ_FIXED / WRITE_FIXED). Linux 5.1+; unregistered
+//                      buffers (READ / WRITE) need 5.6+.
+//   ThreadPoolBackend  a few threads doing blocking pread/pwrite; used when
+//                      io_uring is not available.
+//
+// Both resubmit short transfers internally: wait() only returns a request
+// once it has moved all its bytes or failed.
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+struct IoRequest {
+    int fd = -1;
+    bool write = false;
+    uint8_t* buf = nullptr;
+    size_t size = 0;
+    uint64_t offset = 0;
+    int buf_index = -1;         // registered buffer holding 'buf', or -1
+    void* user = nullptr;       // caller's context
+
+    // Filled in by the backend
+    size_t done = 0;
+    int error = 0;              // errno of a failed transfer, 0 on success
+};
+
+class BatchIoBackend {
+public:
+    virtual ~BatchIoBackend() {}
+    virtual const char* name() const = 0;
+    // Queue a request. Safe to call from any thread.
+    virtual void submit(IoRequest* req) = 0;
+    // Block until a request completes. Call from one thread only.
+    virtual IoRequest* wait() = 0;
+};
+
+class ThreadPoolBackend : public BatchIoBackend {
+public:
+    explicit ThreadPoolBackend(int threads) : stop_(false) {
+        for (int i = 0; i < std::max(1, threads); i++) {
+            threads_.emplace_back([this] { run(); });
+        }
+    }
+
+    ~ThreadPoolBackend() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        pending_cond_.notify_all();
+        for (std::thread& t : threads_) t.join();
+    }
+
+    const char* name() const override { return "threads"; }
+
+    void submit(IoRequest* req) override {
+        req->done = 0;
+        req->error = 0;
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(req);
+        pending_cond_.notify_one();
+    }
+
+    IoRequest* wait() override {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cond_.wait(lock, [this] { return !completed_.empty(); });
+        IoRequest* req = completed_.front();
+        completed_.pop_front();
+        return req;
+    }
+
+private:
+    void run() {
+        for (;;) {
+            IoRequest* req;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                pending_cond_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+                if (stop_) return;
+                req = pending_.front();
+                pending_.pop_front();
+            }
+            while (req->done < req->size) {
+                ssize_t n = req->write
+                    ? pwrite(req->fd, req->buf + req->done, req->size - req->done, req->offset + req->done)
+                    : pread(req->fd, req->buf + req->done, req->size - req->done, req->offset + req->done);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) {
+                    req->error = n < 0 ? errno : EIO;
+                    break;
+                }
+                req->done += (size_t)n;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            completed_.push_back(req);
+            done_cond_.notify_one();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable pending_cond_, done_cond_;
+    std::deque<IoRequest*> pending_, completed_;
+    std::vector<std::thread> threads_;
+    bool stop_;
+};
+
+#ifdef __linux__
+
+// io_uring through the raw syscalls, so no liburing dependency is needed
+class UringBackend : public BatchIoBackend {
+public:
+    ~UringBackend() override {
+        if (sqes_) munmap(sqes_, sqes_size_);
+        if (cq_ptr_ && cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_size_);
+        if (sq_ptr_) munmap(sq_ptr_, sq_size_);
+        if (ring_fd_ >= 0) close(ring_fd_);
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+    // Create a ring for up to 'entries' requests in flight and register the
+    // given buffers. Returns false (with errno set) if io_uring is unusable.
+    // A failed buffer registration falls back to plain READ / WRITE, which
+    // need Linux 5.6; without them init() fails with EOPNOTSUPP so the caller
+    // can use ThreadPoolBackend instead of failing every request.
+    bool init(unsigned entries, const std::vector<iovec>& buffers) {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        ring_fd_ = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (ring_fd_ < 0) return false;
+
+        sq_size_ = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+        cq_size_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+
+        sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_ptr_ == MAP_FAILED) { sq_ptr_ = nullptr; return false; }
+        if (single_mmap) {
+            cq_ptr_ = sq_ptr_;
+        } else {
+            cq_ptr_ = mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ring_fd_, IORING_OFF_CQ_RING);
+            if (cq_ptr_ == MAP_FAILED) { cq_ptr_ = nullptr; return false; }
+        }
+        sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring_fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) return false;
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        char* sq = static_cast<char*>(sq_ptr_);
+        sq_head_ = reinterpret_cast<uint32_t*>(sq + p.sq_off.head);
+        sq_tail_ = reinterpret_cast<uint32_t*>(sq + p.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<uint32_t*>(sq + p.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<uint32_t*>(sq + p.sq_off.array);
+        sq_entries_ = p.sq_entries;
+
+        char* cq = static_cast<char*>(cq_ptr_);
+        cq_head_ = reinterpret_cast<uint32_t*>(cq + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<uint32_t*>(cq + p.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<uint32_t*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+
+        if (!buffers.empty()) {
+            fixed_buffers_ = syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_BUFFERS,
+                                     buffers.data(), (unsigned)buffers.size()) == 0;
+        }
+        if (!fixed_buffers_ && !supports_unregistered_io()) {
+            errno = EOPNOTSUPP;
+            return false;
+        }
+        return true;
+    }
+
+    bool fixed_buffers() const { return fixed_buffers_; }
+
+    void submit(IoRequest* req) override {
+        req->done = 0;
+        req->error = 0;
+        queue(req);
+    }
+
+    IoRequest* wait() override {
+        for (;;) {
+            uint32_t head = *cq_head_;
+            if (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+                io_uring_cqe cqe = cqes_[head & cq_mask_];
+                __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+
+                IoRequest* req = reinterpret_cast<IoRequest*>(cqe.user_data);
+                if (cqe.res < 0) {
+                    req->error = -cqe.res;
+                    return req;
+                }
+                if (cqe.res == 0 && req->done < req->size) {
+                    req->error = EIO;       // unexpected end of file
+                    return req;
+                }
+                req->done += (size_t)cqe.res;
+                if (req->done < req->size) {
+                    queue(req);             // short transfer, continue
+                    continue;
+                }
+                return req;
+            }
+            if (syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+                errno != EINTR) {
+                return nullptr;
+            }
+        }
+    }
+
+private:
+    void queue(IoRequest* req) {
+        std::lock_guard<std::mutex> lock(sq_mutex_);
+        uint32_t tail = *sq_tail_;
+        // The kernel consumes entries during io_uring_enter, so the ring only
+        // fills up if more requests are in flight than it was sized for
+        while (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+            std::this_thread::yield();
+        }
+        uint32_t index = tail & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        memset(sqe, 0, sizeof(*sqe));
+        bool fixed = fixed_buffers_ && req->buf_index >= 0;
+        if (req->write) {
+            sqe->opcode = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        } else {
+            sqe->opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        }
+        sqe->fd = req->fd;
+        sqe->addr = reinterpret_cast<uint64_t>(req->buf + req->done);
+        sqe->len = (uint32_t)std::min<size_t>(req->size - req->done, 1u << 30);
+        sqe->off = req->offset + req->done;
+        if (fixed) sqe->buf_index = (uint16_t)req->buf_index;
+        sqe->user_data = reinterpret_cast<uint64_t>(req);
+        sq_array_[index] = index;
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+        while (syscall(__NR_io_uring_enter, ring_fd_, 1, 0, 0, nullptr, 0) < 0 && errno == EINTR) {
+        }
+    }
+
+    // Whether the kernel has IORING_OP_READ and IORING_OP_WRITE. The probe
+    // itself arrived with them in 5.6, so a failed probe means no.
+    bool supports_unregistered_io() const {
+        const unsigned kOps = 256;
+        std::vector<uint8_t> storage(sizeof(io_uring_probe) + kOps * sizeof(io_uring_probe_op), 0);
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+        if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PROBE, probe, kOps) != 0) {
+            return false;
+        }
+        auto supported = [&](unsigned op) {
+            return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+        };
+        return supported(IORING_OP_READ) && supported(IORING_OP_WRITE);
+    }
+
+    int ring_fd_ = -1;
+    void* sq_ptr_ = nullptr;
+    void* cq_ptr_ = nullptr;
+    size_t sq_size_ = 0, cq_size_ = 0, sqes_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    uint32_t *sq_head_ = nullptr, *sq_tail_ = nullptr, *sq_array_ = nullptr;
+    uint32_t sq_mask_ = 0, sq_entries_ = 0;
+    uint32_t *cq_head_ = nullptr, *cq_tail_ = nullptr;
+    uint32_t cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    bool fixed_buffers_ = false;
+    std::mutex sq_mutex_;
+};
+
+#endif // __linux__
@@ -0,0 +1,277 @@
+// BatchShards.h - Frame sources for SimpleColorKeyerBatch
+//
+// RangeSource hands out every frame of the range. ShardSource lets any
+// number of processes - on one machine or several sharing a filesystem -
+// split a range with no central scheduler:
+//
+//   - the range is cut into fixed-size chunks; a process claims a chunk by
+//     creating <state>/chunk.<first>-<last>.claim with O_CREAT | O_EXCL
+//   - while a chunk is being worked on its claim file's mtime is refreshed,
+//     so a claim that stops being refreshed (killed job) goes stale and
+//     another process takes it over by renaming it aside; the renamed file
+//     is checked again, since a competing taker may have replaced the stale
+//     claim with a fresh one in the meantime
+//   - a claim file names its owner; heartbeats and releases only touch a
+//     claim that still names this process
+//   - a finished chunk gets a .done marker and is never claimed again; a
+//     chunk with a failed frame is released and not claimed again by the
+//     same process, which ends with an error once the rest is done
+//   - inside a claimed chunk, frames whose final output already exists are
+//     skipped (checked by exact size, or existence when out_size is 0);
+//     outputs are written to a temp file and renamed into place,
+//     so an existing output is always complete
+#pragma once
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+class FrameSource {
+public:
+    virtual ~FrameSource() {}
+    // Next frame to key; false when there is no more work for this process
+    virtual bool next(int& frame) = 0;
+    // A frame handed out by next() has been written (ok) or failed
+    virtual void finished(int frame, bool ok) { (void)frame; (void)ok; }
+    // Called regularly from the batch loop
+    virtual void tick() {}
+    virtual int skipped() const { return 0; }
+};
+
+class RangeSource : public FrameSource {
+public:
+    RangeSource(int first, int last) : next_(first), last_(last) {}
+    bool next(int& frame) override {
+        if (next_ > last_) return false;
+        frame = next_++;
+        return true;
+    }
+private:
+    int next_, last_;
+};
+
+class ShardSource : public FrameSource {
+public:
+    ShardSource(const std::string& state_dir, int first, int last, int chunk_size,
+                int stale_seconds, const std::string& out_pattern, size_t out_size)
+        : state_dir_(state_dir), first_(first), last_(last), chunk_size_(std::max(1, chunk_size)),
+          stale_seconds_(stale_seconds), out_pattern_(out_pattern), out_size_(out_size) {
+        char host[256] = "localhost";
+        gethostname(host, sizeof(host) - 1);
+        owner_ = std::string(host) + ":" + std::to_string(getpid());
+        mkdir(state_dir_.c_str(), 0775);
+        chunk_count_ = (last_ - first_) / chunk_size_ + 1;
+        // Start at a different chunk per process so claims rarely collide
+        start_chunk_ = (int)((unsigned)getpid() % (unsigned)chunk_count_);
+    }
+
+    ~ShardSource() override {
+        // Give back chunks that were not completed (early exit)
+        for (const Chunk& c : active_) release_claim(c.index);
+    }
+
+    bool next(int& frame) override {
+        for (;;) {
+            if (current_ < 0 && !claim_next()) return false;
+            Chunk& c = chunk(current_);
+            while (c.next <= c.last) {
+                int f = c.next++;
+                if (output_complete(f)) {
+                    skipped_++;
+                    continue;
+                }
+                c.outstanding++;
+                frame = f;
+                return true;
+            }
+            c.issued = true;
+            current_ = -1;
+            maybe_complete(c.index);
+        }
+    }
+
+    void finished(int frame, bool ok) override {
+        int index = (frame - first_) / chunk_size_;
+        for (Chunk& c : active_) {
+            if (c.index != index) continue;
+            c.outstanding--;
+            if (!ok) c.failed = true;
+            maybe_complete(index);
+            return;
+        }
+    }
+
+    void tick() override {
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_heartbeat_ < std::chrono::seconds(std::max(1, stale_seconds_ / 4))) return;
+        last_heartbeat_ = now;
+        for (const Chunk& c : active_) {
+            // A claim taken over while this process stalled is no longer ours
+            if (read_owner(claim_path(c.index)) == owner_) {
+                utimensat(AT_FDCWD, claim_path(c.index).c_str(), nullptr, 0);
+            }
+        }
+    }
+
+    int skipped() const override { return skipped_; }
+    int chunks_completed() const { return chunks_completed_; }
+    int chunks_taken_over() const { return chunks_taken_over_; }
+    int chunks_failed() const { return (int)failed_chunks_.size(); }
+    const std::string& owner() const { return owner_; }
+
+    // Append one line to <state>/progress.log (O_APPEND keeps lines whole)
+    void log_progress(const char* line) const {
+        int fd = open((state_dir_ + "/progress.log").c_str(), O_WRONLY | O_CREAT | O_APPEND, 0664);
+        if (fd < 0) return;
+        std::string text = owner_ + " " + line + "\n";
+        ssize_t n = write(fd, text.data(), text.size());
+        (void)n;
+        close(fd);
+    }
+
+private:
+    struct Chunk {
+        int index, next, last;
+        int outstanding = 0;
+        bool issued = false;
+        bool failed = false;
+    };
+
+    std::string chunk_name(int index) const {
+        int f0 = first_ + index * chunk_size_;
+        int f1 = std::min(last_, f0 + chunk_size_ - 1);
+        return state_dir_ + "/chunk." + std::to_string(f0) + "-" + std::to_string(f1);
+    }
+    std::string claim_path(int index) const { return chunk_name(index) + ".claim"; }
+    std::string done_path(int index) const { return chunk_name(index) + ".done"; }
+
+    Chunk& chunk(int index) {
+        for (Chunk& c : active_) {
+            if (c.index == index) return c;
+        }
+        return active_.front();     // not reached: current_ is always active
+    }
+
+    bool output_complete(int frame) const {
+        char path[4096];
+        snprintf(path, sizeof(path), out_pattern_.c_str(), frame);
+        struct stat st;
+        return stat(path, &st) == 0 && (out_size_ == 0 || (size_t)st.st_size == out_size_);
+    }
+
+    // First line of a claim file: the owner that created it
+    static std::string read_owner(const std::string& path) {
+        char text[512] = {};
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return std::string();
+        ssize_t n = read(fd, text, sizeof(text) - 1);
+        close(fd);
+        if (n <= 0) return std::string();
+        text[n] = 0;
+        return std::string(text, strcspn(text, "\n"));
+    }
+
+    bool is_stale(const struct stat& st) const {
+        return time(nullptr) - st.st_mtime >= stale_seconds_;
+    }
+
+    // Remove this process's claim on a chunk, unless it was taken over
+    void release_claim(int index) const {
+        if (read_owner(claim_path(index)) == owner_) unlink(claim_path(index).c_str());
+    }
+
+    bool try_claim(int index) {
+        std::string claim = claim_path(index);
+        int fd = open(claim.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0664);
+        if (fd < 0 && errno == EEXIST) {
+            // Someone holds it - take over only if its heartbeat stopped
+            struct stat st;
+            if (stat(claim.c_str(), &st) != 0 || !is_stale(st)) return false;
+            const std::string stale_owner = read_owner(claim);
+            std::string stale = claim + ".stale." + owner_;
+            if (rename(claim.c_str(), stale.c_str()) != 0) return false;
+            // Between the stat and the rename another process may have taken
+            // the chunk over and created a fresh claim, which we just moved:
+            // put it back and leave the chunk to that process
+            if (stat(stale.c_str(), &st) != 0 || !is_stale(st) || read_owner(stale) != stale_owner) {
+                if (link(stale.c_str(), claim.c_str()) != 0 && errno != EEXIST) {
+                    fprintf(stderr, "%s: could not restore claim: %s\n", claim.c_str(), strerror(errno));
+                }
+                unlink(stale.c_str());
+                return false;
+            }
+            unlink(stale.c_str());
+            fd = open(claim.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0664);
+            if (fd >= 0) chunks_taken_over_++;
+        }
+        if (fd < 0) return false;
+        std::string text = owner_ + "\n";
+        ssize_t n = write(fd, text.data(), text.size());
+        (void)n;
+        close(fd);
+        return true;
+    }
+
+    bool claim_next() {
+        for (int i = 0; i < chunk_count_; i++) {
+            int index = (start_chunk_ + scanned_ + i) % chunk_count_;
+            if (access(done_path(index).c_str(), F_OK) == 0) continue;
+            // Retrying a chunk that failed here would fail the same way
+            if (std::find(failed_chunks_.begin(), failed_chunks_.end(), index) != failed_chunks_.end()) {
+                continue;
+            }
+            if (!try_claim(index)) continue;
+            // A claim may have been taken over just after its owner finished
+            if (access(done_path(index).c_str(), F_OK) == 0) {
+                release_claim(index);
+                continue;
+            }
+            scanned_ += i + 1;
+            Chunk c;
+            c.index = index;
+            c.next = first_ + index * chunk_size_;
+            c.last = std::min(last_, c.next + chunk_size_ - 1);
+            active_.push_back(c);
+            current_ = index;
+            return true;
+        }
+        return false;
+    }
+
+    void maybe_complete(int index) {
+        for (size_t i = 0; i < active_.size(); i++) {
+            Chunk& c = active_[i];
+            if (c.index != index || !c.issued || c.outstanding > 0) continue;
+            if (!c.failed) {
+                int fd = open(done_path(index).c_str(), O_WRONLY | O_CREAT, 0664);
+                if (fd >= 0) close(fd);
+                chunks_completed_++;
+            } else {
+                failed_chunks_.push_back(index);
+            }
+            release_claim(index);
+            active_.erase(active_.begin() + i);
+            return;
+        }
+    }
+
+    std::string state_dir_;
+    int first_, last_, chunk_size_, stale_seconds_;
+    std::string out_pattern_;
+    size_t out_size_;
+    std::string owner_;
+    int chunk_count_ = 0, start_chunk_ = 0, scanned_ = 0;
+    int current_ = -1;
+    std::vector<Chunk> active_;
+    std::vector<int> failed_chunks_;
+    int skipped_ = 0, chunks_completed_ = 0, chunks_taken_over_ = 0;
+    std::chrono::steady_clock::time_point last_heartbeat_;
+};
@@ -0,0 +1,163 @@
+// CleanPlate.h - Streaming per-pixel median for clean screen plates
+//
+// A temporal median over a shot removes talent and props that cross the
+// screen, leaving the screen itself. Instead of holding every frame,
+// CleanPlateBuilder keeps a P-squared quantile estimator (Jain & Chlamtac)
+// per pixel and channel: five markers that track the minimum, the median,
+// the maximum and the two quartiles in between, updated with each new
+// frame. Memory is fixed at 84 bytes per pixel regardless of shot length,
+// and the estimate converges on the true median as frames accumulate.
+//
+// The result is a planar float RGB plate; keying each pixel against its
+// plate value (key_row_plate) follows uneven screen lighting.
+#pragma once
+
+#include "../SimpleColorKeyerTasks.h"
+#include "RawFrameFormats.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// P-squared median estimator for one channel of one pixel. The outer
+// marker positions are implied (1 and the sample count); the inner ones
+// fit in 16 bits, which caps a plate at 65535 frames.
+struct P2Median {
+    float q[5];                 // marker heights
+    uint16_t n[3];              // positions of markers 1-3 (1-based)
+};
+
+// Desired positions of the inner markers after 'count' samples, shared by
+// every pixel because all pixels see the same number of samples
+struct P2Targets {
+    float n[3];
+    explicit P2Targets(int count) {
+        n[0] = 1.0f + (count - 1) * 0.25f;
+        n[1] = 1.0f + (count - 1) * 0.5f;
+        n[2] = 1.0f + (count - 1) * 0.75f;
+    }
+};
+
+// Add sample x to an estimator that has already seen 'seen' samples
+inline void p2_add(P2Median& m, float x, int seen, const P2Targets& target) {
+    if (seen < 5) {
+        // Collect the first five samples, then sort them into the markers
+        m.q[seen] = x;
+        if (seen == 4) {
+            std::sort(m.q, m.q + 5);
+            m.n[0] = 2;
+            m.n[1] = 3;
+            m.n[2] = 4;
+        }
+        return;
+    }
+
+    const int count = seen + 1;
+    int pos[5] = { 1, m.n[0], m.n[1], m.n[2], seen };
+    int k;
+    if (x < m.q[0]) {
+        m.q[0] = x;
+        k = 0;
+    } else if (x < m.q[1]) {
+        k = 0;
+    } else if (x < m.q[2]) {
+        k = 1;
+    } else if (x < m.q[3]) {
+        k = 2;
+    } else if (x <= m.q[4]) {
+        k = 3;
+    } else {
+        m.q[4] = x;
+        k = 3;
+    }
+    for (int i = k + 1; i < 5; i++) pos[i]++;
+    pos[4] = count;
+
+    for (int i = 1; i <= 3; i++) {
+        float d = target.n[i - 1] - pos[i];
+        if ((d >= 1.0f && pos[i + 1] - pos[i] > 1) || (d <= -1.0f && pos[i - 1] - pos[i] < -1)) {
+            const int s = d > 0.0f ? 1 : -1;
+            const float qi = m.q[i], qm = m.q[i - 1], qp = m.q[i + 1];
+            const float nm = (float)pos[i - 1], ni = (float)pos[i], np = (float)pos[i + 1];
+            // Piecewise-parabolic prediction, falling back to linear when it
+            // would break marker ordering
+            float q = qi + s / (np - nm) *
+                      ((ni - nm + s) * (qp - qi) / (np - ni) + (np - ni - s) * (qi - qm) / (ni - nm));
+            if (!(qm < q && q < qp)) {
+                const float qn = m.q[i + s];
+                q = qi + s * (qn - qi) / ((float)pos[i + s] - ni);
+            }
+            m.q[i] = q;
+            pos[i] += s;
+        }
+    }
+    m.n[0] = (uint16_t)pos[1];
+    m.n[1] = (uint16_t)pos[2];
+    m.n[2] = (uint16_t)pos[3];
+}
+
+// Current median estimate after 'seen' samples
+inline float p2_median(const P2Median& m, int seen) {
+    if (seen >= 5) return m.q[2];
+    if (seen <= 0) return 0.0f;
+    float v[5];
+    std::copy(m.q, m.q + seen, v);
+    std::sort(v, v + seen);
+    return seen & 1 ? v[seen / 2] : 0.5f * (v[seen / 2 - 1] + v[seen / 2]);
+}
+
+class CleanPlateBuilder {
+public:
+    static const int kMaxFrames = 65535;
+
+    CleanPlateBuilder(int width, int height, int in_format)
+        : width_(width), height_(height), in_format_(in_format),
+          state_((size_t)width * height * 3) {}
+
+    int frames() const { return seen_; }
+    bool full() const { return seen_ >= kMaxFrames; }
+
+    // Fold one raw input frame into the estimate, using 'threads' threads
+    // over bands of rows
+    void add_frame(const uint8_t* frame, int threads) {
+        if (full()) return;
+        threads = std::max(1, threads);
+        if (!pool_ || pool_->threads() != threads) {
+            pool_.reset(new TaskPool(threads));
+            rows_.assign((size_t)pool_->threads() * width_ * 3, 0.0f);
+        }
+        const P2Targets target(seen_ + 1);
+        pool_->parallel_for(0, height_, 16, [&](int y0, int y1, int worker) {
+            float* r = &rows_[(size_t)worker * width_ * 3];
+            float* g = r + width_;
+            float* b = g + width_;
+            for (int y = y0; y < y1; y++) {
+                decode_row(in_format_, frame, width_, height_, y, r, g, b);
+                P2Median* m = &state_[(size_t)y * width_ * 3];
+                for (int x = 0; x < width_; x++, m += 3) {
+                    p2_add(m[0], r[x], seen_, target);
+                    p2_add(m[1], g[x], seen_, target);
+                    p2_add(m[2], b[x], seen_, target);
+                }
+            }
+        });
+        seen_++;
+    }
+
+    // Median estimate for row y as planar float RGB
+    void plate_row(int y, float* r, float* g, float* b) const {
+        const P2Median* m = &state_[(size_t)y * width_ * 3];
+        for (int x = 0; x < width_; x++, m += 3) {
+            r[x] = p2_median(m[0], seen_);
+            g[x] = p2_median(m[1], seen_);
+            b[x] = p2_median(m[2], seen_);
+        }
+    }
+
+private:
+    int width_, height_, in_format_;
+    int seen_ = 0;
+    std::vector<P2Median> state_;       // [pixel][channel]
+    std::unique_ptr<TaskPool> pool_;
+    std::vector<float> rows_;           // per-worker decoded RGB row
+};
@@ -0,0 +1,212 @@
+// IncrementalKeyer.h - Tile-hash incremental keying for locked-off plates
+//
+// On a locked-off shot most of the screen is identical from one frame to
+// the next. IncrementalKeyer splits each frame into fixed-size tiles,
+// hashes the raw input bytes of every tile and re-keys only the tiles whose
+// hash differs from the previous frame's; the alpha of unchanged tiles is
+// left in place in the persistent alpha buffer. Any change to the keyer
+// parameters invalidates every tile.
+//
+// Frames must be fed in sequence order for the reuse to be meaningful.
+#pragma once
+
+#include "../SimpleColorKeyerCore.h"
+#include "../SimpleColorKeyerTasks.h"
+#include "RawFrameFormats.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// 64-bit non-cryptographic hash of a byte span, chainable through 'seed'
+inline uint64_t tile_hash(const uint8_t* p, size_t n, uint64_t seed) {
+    const uint64_t k1 = 0x9e3779b185ebca87ull, k2 = 0xc2b2ae3d27d4eb4full;
+    uint64_t h = seed ^ (n * k1);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t v;
+        memcpy(&v, p + i, 8);
+        h ^= v * k2;
+        h = ((h << 31) | (h >> 33)) * k1;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p + i, n - i);
+    h ^= tail * k2;
+    h ^= h >> 29;
+    h *= k1;
+    h ^= h >> 32;
+    return h;
+}
+
+inline uint64_t params_hash(const KeyerParams& p) {
+    uint64_t h = 0;
+    h = tile_hash(reinterpret_cast<const uint8_t*>(p.key_color), sizeof(p.key_color), h);
+    const float values[] = { p.variance, p.range_red, p.range_magenta, p.range_green,
+                             p.range_yellow, p.range_blue, p.range_cyan, p.gain,
+                             p.invert ? 1.0f : 0.0f, (float)p.keying_method };
+    return tile_hash(reinterpret_cast<const uint8_t*>(values), sizeof(values), h);
+}
+
+class IncrementalKeyer {
+public:
+    struct Stats {
+        uint64_t tiles = 0;             // tiles examined
+        uint64_t reused = 0;            // tiles whose alpha was kept
+        int frames = 0;
+        double total_seconds = 0.0;     // wall time of key_frame(), all frames
+        // Frames that reused no tile (the first, and after a parameter
+        // change): a full key, timed the same way
+        int full_frames = 0;
+        double full_seconds = 0.0;
+    };
+
+    IncrementalKeyer(int width, int height, int in_format, int bytes_per_pixel, int tile_size)
+        : width_(width), height_(height), in_format_(in_format), bpp_(bytes_per_pixel),
+          tile_(std::max(8, tile_size)), alpha_((size_t)width * height) {
+        tiles_x_ = (width_ + tile_ - 1) / tile_;
+        tiles_y_ = (height_ + tile_ - 1) / tile_;
+        hashes_.assign((size_t)tiles_x_ * tiles_y_, 0);
+        valid_.assign(hashes_.size(), 0);
+    }
+
+    // Key against a per-pixel key color (planar float RGB, width x height)
+    // instead of params.key_color. The plate must outlive the keyer.
+    void set_plate(const float* r, const float* g, const float* b) {
+        plate_[0] = r;
+        plate_[1] = g;
+        plate_[2] = b;
+        std::fill(valid_.begin(), valid_.end(), 0);
+    }
+
+    // Key one raw input frame into alpha(), using 'threads' threads over tile
+    // rows (a persistent TaskPool, recreated when 'threads' changes)
+    void key_frame(const uint8_t* frame, const KeyerParams& params, int threads) {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t phash = params_hash(params);
+        if (phash != params_hash_) {
+            std::fill(valid_.begin(), valid_.end(), 0);
+            params_hash_ = phash;
+        }
+
+        threads = std::max(1, threads);
+        if (!pool_ || pool_->threads() != threads) {
+            pool_.reset(new TaskPool(threads));
+            scratch_.assign(pool_->threads(), Scratch());
+        }
+
+        std::atomic<uint64_t> reused(0);
+        pool_->parallel_for(0, tiles_y_, 1, [&](int ty0, int ty1, int worker) {
+            Scratch& s = scratch_[worker];
+            s.r.resize(width_);
+            s.g.resize(width_);
+            s.b.resize(width_);
+            std::vector<int>& changed = s.changed;
+            float* r = s.r.data();
+            float* g = s.g.data();
+            float* b = s.b.data();
+            for (int ty = ty0; ty < ty1; ty++) {
+                changed.clear();
+                for (int tx = 0; tx < tiles_x_; tx++) {
+                    size_t t = (size_t)ty * tiles_x_ + tx;
+                    uint64_t h = hash_tile(frame, tx, ty);
+                    if (valid_[t] && hashes_[t] == h) {
+                        reused++;
+                        continue;
+                    }
+                    hashes_[t] = h;
+                    valid_[t] = 1;
+                    changed.push_back(tx);
+                }
+                if (changed.empty()) continue;
+
+                // Decode each row of the band once and key only the changed spans
+                const int y0 = ty * tile_, y1 = std::min(height_, y0 + tile_);
+                for (int y = y0; y < y1; y++) {
+                    decode_row(in_format_, frame, width_, height_, y, r, g, b);
+                    for (int tx : changed) {
+                        const int x0 = tx * tile_, x1 = std::min(width_, x0 + tile_);
+                        const size_t at = (size_t)y * width_ + x0;
+                        if (plate_[0]) {
+                            key_row_plate(params, r + x0, g + x0, b + x0,
+                                          plate_[0] + at, plate_[1] + at, plate_[2] + at,
+                                          alpha_.data() + at, x1 - x0);
+                        } else {
+                            key_row(params, r + x0, g + x0, b + x0,
+                                    alpha_.data() + at, x1 - x0);
+                        }
+                    }
+                }
+            }
+        });
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats_.tiles += hashes_.size();
+        stats_.reused += reused.load();
+        stats_.frames++;
+        stats_.total_seconds += seconds;
+        if (reused.load() == 0) {
+            stats_.full_frames++;
+            stats_.full_seconds += seconds;
+        }
+    }
+
+    const float* alpha() const { return alpha_.data(); }
+    const Stats& stats() const { return stats_; }
+
+    // Speedup over keying every frame in full: the mean wall time of the
+    // frames that were keyed in full, times the frame count, over the total
+    // wall time. Both are measured at the same thread count; a full frame
+    // also hashes its tiles, so this is an estimate (and 0 with no full
+    // frame to compare against).
+    double estimated_speedup() const {
+        if (stats_.full_frames == 0 || stats_.total_seconds <= 0.0) return 0.0;
+        double full = stats_.full_seconds / stats_.full_frames * stats_.frames;
+        return full / stats_.total_seconds;
+    }
+
+private:
+    bool planar() const { return in_format_ == IN_GBRP16LE || in_format_ == IN_GBRPF32LE; }
+
+    uint64_t hash_tile(const uint8_t* frame, int tx, int ty) const {
+        const int x0 = tx * tile_, x1 = std::min(width_, x0 + tile_);
+        const int y0 = ty * tile_, y1 = std::min(height_, y0 + tile_);
+        uint64_t h = (uint64_t)(ty * tiles_x_ + tx);
+        if (planar()) {
+            // Planar formats: bpp_ covers all three planes
+            const int sample = bpp_ / 3;
+            const size_t plane = (size_t)width_ * height_ * sample;
+            for (int p = 0; p < 3; p++) {
+                for (int y = y0; y < y1; y++) {
+                    const uint8_t* row = frame + p * plane + ((size_t)y * width_ + x0) * sample;
+                    h = tile_hash(row, (size_t)(x1 - x0) * sample, h);
+                }
+            }
+        } else {
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* row = frame + ((size_t)y * width_ + x0) * bpp_;
+                h = tile_hash(row, (size_t)(x1 - x0) * bpp_, h);
+            }
+        }
+        return h;
+    }
+
+    int width_, height_, in_format_, bpp_, tile_;
+    int tiles_x_ = 0, tiles_y_ = 0;
+    std::vector<float> alpha_;
+    std::vector<uint64_t> hashes_;
+    std::vector<uint8_t> valid_;
+    uint64_t params_hash_ = 0;
+    const float* plate_[3] = { nullptr, nullptr, nullptr };
+    Stats stats_;
+
+    // Per-worker decode rows and list of changed tiles
+    struct Scratch {
+        std::vector<float> r, g, b;
+        std::vector<int> changed;
+    };
+    std::unique_ptr<TaskPool> pool_;
+    std::vector<Scratch> scratch_;
+};
@@ -0,0 +1,145 @@
+// KeyLut.h - The keyer sampled onto a 3D lattice
+//
+// The alpha of every keying method is a function of the pixel's RGB alone,
+// so it can be baked into a 3D LUT and applied wherever LUTs are cheap
+// (review players, on-set monitors, display hardware). build_key_lut()
+// samples key_pixel() - method, expansion, gain and invert included - at
+// every lattice point; lut_alpha() interpolates it trilinearly, the way
+// LUT hardware does, and measure_lut_error() compares the two.
+#pragma once
+
+#include "../SimpleColorKeyerCore.h"
+#include "../SimpleColorKeyerTasks.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+struct KeyLut {
+    int size = 0;                   // lattice points per axis
+    float domain_min = 0.0f;        // input value at the first / last point
+    float domain_max = 1.0f;
+    std::vector<float> alpha;       // size^3, red fastest, then green, then blue
+
+    float at(int r, int g, int b) const { return alpha[((size_t)b * size + g) * size + r]; }
+    float value_of(int index) const { return domain_min + (domain_max - domain_min) * index / (size - 1); }
+};
+
+inline KeyLut build_key_lut(const KeyerParams& params, int size, float domain_min, float domain_max,
+                            TaskPool& pool) {
+    KeyLut lut;
+    lut.size = size;
+    lut.domain_min = domain_min;
+    lut.domain_max = domain_max;
+    lut.alpha.resize((size_t)size * size * size);
+    const Color3 key = params.key();
+    pool.parallel_for(0, size, 1, [&](int b0, int b1, int) {
+        for (int b = b0; b < b1; b++) {
+            for (int g = 0; g < size; g++) {
+                float* out = &lut.alpha[((size_t)b * size + g) * size];
+                for (int r = 0; r < size; r++) {
+                    out[r] = key_pixel(params, Color3(lut.value_of(r), lut.value_of(g), lut.value_of(b)), key);
+                }
+            }
+        }
+    });
+    return lut;
+}
+
+// Trilinear lookup; inputs outside the domain are clamped to it
+inline float lut_alpha(const KeyLut& lut, float r, float g, float b) {
+    const float scale = (lut.size - 1) / (lut.domain_max - lut.domain_min);
+    int i[3];
+    float f[3];
+    const float c[3] = { r, g, b };
+    for (int k = 0; k < 3; k++) {
+        float v = std::min(std::max((c[k] - lut.domain_min) * scale, 0.0f), (float)(lut.size - 1));
+        i[k] = std::min((int)v, lut.size - 2);
+        f[k] = v - i[k];
+    }
+    auto lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+    float v[2][2];
+    for (int db = 0; db < 2; db++) {
+        for (int dg = 0; dg < 2; dg++) {
+            v[db][dg] = lerp(lut.at(i[0], i[1] + dg, i[2] + db), lut.at(i[0] + 1, i[1] + dg, i[2] + db), f[0]);
+        }
+    }
+    return lerp(lerp(v[0][0], v[0][1], f[1]), lerp(v[1][0], v[1][1], f[1]), f[2]);
+}
+
+struct LutError {
+    double max = 0.0;               // largest |lut - exact| alpha
+    double mean = 0.0;
+    double above_8bit = 0.0;        // fraction of samples off by more than 1/255
+    Color3 worst;                   // input where the largest error occurs
+    uint64_t samples = 0;
+};
+
+// Interpolation error over 'samples' uniformly random inputs in the domain
+// plus the center of every lattice cell (where trilinear error peaks)
+inline LutError measure_lut_error(const KeyLut& lut, const KeyerParams& params, uint64_t samples,
+                                  TaskPool& pool) {
+    const Color3 key = params.key();
+    const int cells = lut.size - 1;
+    const int threads = pool.threads();
+    std::vector<LutError> partial(threads);
+    const double step = (lut.domain_max - lut.domain_min) / (double)cells;
+
+    auto check = [&](LutError& e, float r, float g, float b) {
+        double d = std::fabs((double)lut_alpha(lut, r, g, b) - key_pixel(params, Color3(r, g, b), key));
+        e.mean += d;
+        if (d > 1.0 / 255.0) e.above_8bit += 1.0;
+        if (d > e.max) {
+            e.max = d;
+            e.worst = Color3(r, g, b);
+        }
+        e.samples++;
+    };
+
+    // Cell centers, one blue slice of cells per chunk
+    pool.parallel_for(0, cells, 1, [&](int b0, int b1, int worker) {
+        LutError& e = partial[worker];
+        for (int b = b0; b < b1; b++) {
+            for (int g = 0; g < cells; g++) {
+                for (int r = 0; r < cells; r++) {
+                    check(e, (float)(lut.domain_min + (r + 0.5) * step), (float)(lut.domain_min + (g + 0.5) * step),
+                          (float)(lut.domain_min + (b + 0.5) * step));
+                }
+            }
+        }
+    });
+
+    // Random inputs, seeded per chunk so the result does not depend on the
+    // thread count
+    const int chunk = 65536;
+    const int chunks = (int)((samples + chunk - 1) / chunk);
+    pool.parallel_for(0, chunks, 1, [&](int c0, int c1, int worker) {
+        LutError& e = partial[worker];
+        for (int c = c0; c < c1; c++) {
+            std::mt19937 rng(0x5eed + c);
+            std::uniform_real_distribution<float> u(lut.domain_min, lut.domain_max);
+            const uint64_t n = std::min<uint64_t>(chunk, samples - (uint64_t)c * chunk);
+            for (uint64_t k = 0; k < n; k++) {
+                float r = u(rng), g = u(rng), b = u(rng);
+                check(e, r, g, b);
+            }
+        }
+    });
+
+    LutError total;
+    for (const LutError& e : partial) {
+        total.mean += e.mean;
+        total.above_8bit += e.above_8bit;
+        total.samples += e.samples;
+        if (e.max > total.max) {
+            total.max = e.max;
+            total.worst = e.worst;
+        }
+    }
+    if (total.samples) {
+        total.mean /= total.samples;
+        total.above_8bit /= total.samples;
+    }
+    return total;
+}
@@ -0,0 +1,70 @@
+// KeyerToolArgs.h - Command-line keyer settings shared by the standalone tools
+#pragma once
+
+#include "../SimpleColorKeyerCore.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Consume one keyer option at argv[i] (advancing i past its value).
+// Returns false if argv[i] is not a keyer option.
+inline bool parse_keyer_arg(int argc, char** argv, int& i, KeyerParams& p) {
+    const char* a = argv[i];
+    auto value = [&]() -> const char* {
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", a);
+            exit(2);
+        }
+        return argv[++i];
+    };
+
+    if (!strcmp(a, "--key")) {
+        if (sscanf(value(), "%f,%f,%f", &p.key_color[0], &p.key_color[1], &p.key_color[2]) != 3) {
+            fprintf(stderr, "--key expects r,g,b\n");
+            exit(2);
+        }
+    } else if (!strcmp(a, "--tolerance")) {
+        p.variance = (float)atof(value());
+    } else if (!strcmp(a, "--method")) {
+        const char* m = value();
+        if (!strcmp(m, "distance"))      p.keying_method = KEY_DISTANCE;
+        else if (!strcmp(m, "chroma"))   p.keying_method = KEY_CHROMA;
+        else if (!strcmp(m, "luma"))     p.keying_method = KEY_LUMA_WEIGHTED;
+        else if (!strcmp(m, "adaptive")) p.keying_method = KEY_ADAPTIVE;
+        else {
+            fprintf(stderr, "Unknown method: %s\n", m);
+            exit(2);
+        }
+    } else if (!strcmp(a, "--gain")) {
+        p.gain = (float)atof(value());
+    } else if (!strcmp(a, "--invert")) {
+        p.invert = true;
+    } else if (!strcmp(a, "--red")) {
+        p.range_red = (float)atof(value());
+    } else if (!strcmp(a, "--green")) {
+        p.range_green = (float)atof(value());
+    } else if (!strcmp(a, "--blue")) {
+        p.range_blue = (float)atof(value());
+    } else if (!strcmp(a, "--yellow")) {
+        p.range_yellow = (float)atof(value());
+    } else if (!strcmp(a, "--magenta")) {
+        p.range_magenta = (float)atof(value());
+    } else if (!strcmp(a, "--cyan")) {
+        p.range_cyan = (float)atof(value());
+    } else {
+        return false;
+    }
+    return true;
+}
+
+inline void print_keyer_usage(FILE* f) {
+    fprintf(f,
+        "Keyer options (same meaning as the node's knobs):\n"
+        "  --key r,g,b          Key color (default 0,1,0)\n"
+        "  --tolerance v        Tolerance (default 0.3)\n"
+        "  --method m           distance | chroma | luma | adaptive\n"
+        "  --gain v             Alpha gain (default 1)\n"
+        "  --invert             Invert the matte\n"
+        "  --red/--green/--blue/--yellow/--magenta/--cyan v\n"
+        "                       6-direction expansion (-3 to +3)\n");
+}
@@ -0,0 +1,204 @@
+// MiniJson.h - Small JSON reader for the benchmark result files
+//
+// Parses objects, arrays, strings (\uXXXX escapes in the BMP only),
+// numbers, true, false and null into a tree of JsonValue. Not a
+// general-purpose parser: inputs are trusted files produced by
+// SimpleColorKeyerMicroBench.
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+struct JsonValue {
+    enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT } type = NUL;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::map<std::string, JsonValue> object;
+
+    // Member 'key' of an object, or a null value
+    const JsonValue& operator[](const std::string& key) const {
+        static const JsonValue null_value;
+        auto it = object.find(key);
+        return it == object.end() ? null_value : it->second;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : p_(text.c_str()), end_(p_ + text.size()) {}
+
+    // Returns false and sets error() on malformed input
+    bool parse(JsonValue& out) {
+        if (!value(out)) return false;
+        skip_space();
+        if (p_ != end_) return fail("trailing characters");
+        return true;
+    }
+
+    const std::string& error() const { return error_; }
+
+private:
+    bool fail(const char* what) {
+        if (error_.empty()) error_ = what;
+        return false;
+    }
+
+    void skip_space() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t')) p_++;
+    }
+
+    bool literal(const char* word) {
+        size_t n = strlen(word);
+        if ((size_t)(end_ - p_) < n || strncmp(p_, word, n) != 0) return fail("bad literal");
+        p_ += n;
+        return true;
+    }
+
+    bool string(std::string& out) {
+        if (*p_++ != '"') return fail("expected string");
+        while (p_ < end_ && *p_ != '"') {
+            char c = *p_++;
+            if (c != '\\') {
+                out.push_back(c);
+                continue;
+            }
+            if (p_ >= end_) break;
+            char e = *p_++;
+            switch (e) {
+                case 'n': out.push_back('\n'); break;
+                case 't': out.push_back('\t'); break;
+                case 'r': out.push_back('\r'); break;
+                case 'b': out.push_back('\b'); break;
+                case 'f': out.push_back('\f'); break;
+                case 'u': {
+                    if (end_ - p_ < 4) return fail("bad escape");
+                    unsigned code = (unsigned)strtoul(std::string(p_, 4).c_str(), nullptr, 16);
+                    p_ += 4;
+                    // UTF-8 encode (BMP only)
+                    if (code < 0x80) {
+                        out.push_back((char)code);
+                    } else if (code < 0x800) {
+                        out.push_back((char)(0xc0 | (code >> 6)));
+                        out.push_back((char)(0x80 | (code & 0x3f)));
+                    } else {
+                        out.push_back((char)(0xe0 | (code >> 12)));
+                        out.push_back((char)(0x80 | ((code >> 6) & 0x3f)));
+                        out.push_back((char)(0x80 | (code & 0x3f)));
+                    }
+                    break;
+                }
+                default: out.push_back(e); break;
+            }
+        }
+        if (p_ >= end_) return fail("unterminated string");
+        p_++;
+        return true;
+    }
+
+    bool value(JsonValue& out) {
+        skip_space();
+        if (p_ >= end_) return fail("unexpected end");
+        switch (*p_) {
+            case '{': {
+                out.type = JsonValue::OBJECT;
+                p_++;
+                skip_space();
+                if (p_ < end_ && *p_ == '}') {
+                    p_++;
+                    return true;
+                }
+                for (;;) {
+                    skip_space();
+                    std::string key;
+                    if (p_ >= end_ || !string(key)) return fail("expected key");
+                    skip_space();
+                    if (p_ >= end_ || *p_++ != ':') return fail("expected ':'");
+                    if (!value(out.object[key])) return false;
+                    skip_space();
+                    if (p_ < end_ && *p_ == ',') {
+                        p_++;
+                        continue;
+                    }
+                    if (p_ < end_ && *p_ == '}') {
+                        p_++;
+                        return true;
+                    }
+                    return fail("expected ',' or '}'");
+                }
+            }
+            case '[': {
+                out.type = JsonValue::ARRAY;
+                p_++;
+                skip_space();
+                if (p_ < end_ && *p_ == ']') {
+                    p_++;
+                    return true;
+                }
+                for (;;) {
+                    out.array.emplace_back();
+                    if (!value(out.array.back())) return false;
+                    skip_space();
+                    if (p_ < end_ && *p_ == ',') {
+                        p_++;
+                        continue;
+                    }
+                    if (p_ < end_ && *p_ == ']') {
+                        p_++;
+                        return true;
+                    }
+                    return fail("expected ',' or ']'");
+                }
+            }
+            case '"':
+                out.type = JsonValue::STRING;
+                return string(out.string);
+            case 't':
+                out.type = JsonValue::BOOL;
+                out.boolean = true;
+                return literal("true");
+            case 'f':
+                out.type = JsonValue::BOOL;
+                return literal("false");
+            case 'n':
+                return literal("null");
+            default: {
+                char* num_end = nullptr;
+                out.type = JsonValue::NUMBER;
+                out.number = strtod(p_, &num_end);
+                if (num_end == p_) return fail("unexpected character");
+                p_ = num_end;
+                return true;
+            }
+        }
+    }
+
+    const char* p_;
+    const char* end_;
+    std::string error_;
+};
+
+// Read and parse a whole file; prints the reason and returns false on error
+inline bool read_json_file(const char* path, JsonValue& out) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    std::string text;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) text.append(buf, n);
+    fclose(f);
+    JsonParser parser(text);
+    if (!parser.parse(out)) {
+        fprintf(stderr, "%s: invalid JSON (%s)\n", path, parser.error().c_str());
+        return false;
+    }
+    return true;
+}
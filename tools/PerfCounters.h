@@ -0,0 +1,154 @@
+// PerfCounters.h - Grouped hardware counters through perf_event_open
+//
+// Counts user-space cycles, instructions, branch misses, L1D and LLC read
+// misses and stalled cycles for the calling thread between start() and
+// stop(). Events are opened in two groups - cycles, instructions and branch
+// misses; then cache misses and stalls - so each group fits the PMU's
+// counters and is scheduled as a unit, and the kernel multiplexes the two.
+// Events the CPU or kernel does not offer are left out. If cycles cannot be
+// counted (no PMU in a VM, perf_event_paranoid, seccomp) available() is
+// false and the caller carries on with wall-clock numbers only.
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+enum PerfEvent {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_STALLED_FRONTEND,
+    PERF_STALLED_BACKEND,
+    PERF_EVENT_COUNT
+};
+
+static const char* const kPerfEventNames[PERF_EVENT_COUNT] = {
+    "cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses",
+    "stalled_cycles_frontend", "stalled_cycles_backend"
+};
+
+struct PerfSample {
+    bool valid[PERF_EVENT_COUNT] = {};
+    double value[PERF_EVENT_COUNT] = {};   // scaled for multiplexing
+};
+
+class PerfCounters {
+public:
+    PerfCounters() {
+#ifdef __linux__
+        const uint64_t l1d = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        const struct { uint32_t type; uint64_t config; int group; } events[PERF_EVENT_COUNT] = {
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 0 },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 0 },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, 0 },
+            { PERF_TYPE_HW_CACHE, l1d, 1 },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, 1 },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND, 1 },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND, 1 },
+        };
+        for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = events[e].type;
+            attr.config = events[e].config;
+            Group& group = groups_[events[e].group];
+            attr.disabled = group.leader < 0 ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                               PERF_FORMAT_TOTAL_TIME_RUNNING;
+            int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group.leader, 0);
+            if (fd < 0) {
+                if (e == PERF_CYCLES) {
+                    // Without the leader nothing else can be grouped
+                    error_ = std::string("perf_event_open: ") + strerror(errno);
+                    if (errno == EACCES || errno == EPERM) {
+                        error_ += " (check /proc/sys/kernel/perf_event_paranoid)";
+                    } else if (errno == ENOENT || errno == EOPNOTSUPP) {
+                        error_ += " (no hardware PMU, e.g. inside a VM)";
+                    }
+                    return;
+                }
+                continue;
+            }
+            if (group.leader < 0) group.leader = fd;
+            group.fds.push_back(fd);
+            group.events.push_back((PerfEvent)e);
+        }
+#else
+        error_ = "hardware counters need Linux perf_event_open";
+#endif
+    }
+
+    ~PerfCounters() {
+#ifdef __linux__
+        for (const Group& g : groups_) {
+            for (int fd : g.fds) close(fd);
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const { return groups_[0].leader >= 0; }
+    // Why the counters are unavailable
+    const std::string& error() const { return error_; }
+
+    void start() {
+#ifdef __linux__
+        for (const Group& g : groups_) {
+            if (g.leader < 0) continue;
+            ioctl(g.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(g.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+
+    PerfSample stop() {
+        PerfSample s;
+#ifdef __linux__
+        for (const Group& g : groups_) {
+            if (g.leader >= 0) ioctl(g.leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+        for (const Group& g : groups_) {
+            if (g.leader < 0) continue;
+            // nr, time_enabled, time_running, then one value per event
+            std::vector<uint64_t> buf(3 + g.fds.size());
+            ssize_t n = read(g.leader, buf.data(), buf.size() * sizeof(uint64_t));
+            // A group that never got onto the PMU has nothing to report
+            if (n < (ssize_t)(3 * sizeof(uint64_t)) || buf[2] == 0) continue;
+            // The group only ran part of the time: extrapolate
+            const double scale = (double)buf[1] / (double)buf[2];
+            for (size_t i = 0; i < g.events.size() && i < buf[0]; i++) {
+                s.valid[g.events[i]] = true;
+                s.value[g.events[i]] = buf[3 + i] * scale;
+            }
+        }
+#endif
+        return s;
+    }
+
+private:
+    struct Group {
+        int leader = -1;
+        std::vector<int> fds;
+        std::vector<PerfEvent> events;
+    };
+    Group groups_[2];
+    std::string error_;
+};
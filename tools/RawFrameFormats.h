@@ -0,0 +1,222 @@
+// RawFrameFormats.h - Raw pixel formats read and written by the standalone tools
+//
+// Names follow ffmpeg's -pix_fmt spelling so frames can be piped or dumped
+// with ffmpeg's rawvideo muxer. The 10-bit 4:2:2 formats, v210 and p210le,
+// are taken as Rec.709 video range; tools key them with YCbCrKeyer straight
+// from the code values and decode them only for RGB output.
+#pragma once
+
+#include "../SimpleColorKeyerYCbCr.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+enum InFormat { IN_RGB24, IN_RGB48LE, IN_RGBA64LE, IN_GBRP16LE, IN_RGBF32LE, IN_GBRPF32LE, IN_V210, IN_P210LE };
+enum OutFormat { OUT_RGBA, OUT_RGBA64LE, OUT_RGBAF32LE, OUT_GRAY, OUT_GRAY16LE, OUT_GRAYF32LE };
+
+// bytes_per_pixel is 0 where rows are not a whole number of bytes per pixel
+// (v210); use input_frame_bytes() for input frame sizes
+struct FormatName { const char* name; int id; int bytes_per_pixel; };
+
+static const FormatName in_formats[] = {
+    { "rgb24", IN_RGB24, 3 },
+    { "rgb48le", IN_RGB48LE, 6 },
+    { "rgba64le", IN_RGBA64LE, 8 },
+    { "gbrp16le", IN_GBRP16LE, 6 },
+    { "rgbf32le", IN_RGBF32LE, 12 },
+    { "gbrpf32le", IN_GBRPF32LE, 12 },
+    { "v210", IN_V210, 0 },
+    { "p210le", IN_P210LE, 4 },
+};
+
+static const FormatName out_formats[] = {
+    { "rgba", OUT_RGBA, 4 },
+    { "rgba64le", OUT_RGBA64LE, 8 },
+    { "rgbaf32le", OUT_RGBAF32LE, 16 },
+    { "gray", OUT_GRAY, 1 },
+    { "gray16le", OUT_GRAY16LE, 2 },
+    { "grayf32le", OUT_GRAYF32LE, 4 },
+};
+
+template <size_t N>
+inline const FormatName* find_format(const FormatName (&table)[N], const char* name) {
+    for (const FormatName& f : table) {
+        if (!strcmp(f.name, name)) return &f;
+    }
+    return nullptr;
+}
+
+inline bool is_ycbcr(int format) { return format == IN_V210 || format == IN_P210LE; }
+
+// v210 rows hold groups of 6 pixels in four 32-bit words, padded to 128
+// bytes (48 pixels) as ffmpeg writes them
+inline size_t v210_row_bytes(int width) { return (size_t)(width + 47) / 48 * 128; }
+
+// Bytes in one p210le chroma row: a Cb, Cr pair of 16-bit samples per two pixels
+inline size_t p210_chroma_row_bytes(int width) { return (size_t)(width + 1) / 2 * 4; }
+
+inline size_t input_frame_bytes(const FormatName& f, int width, int height) {
+    switch (f.id) {
+        case IN_V210: return v210_row_bytes(width) * height;
+        case IN_P210LE: return ((size_t)width * 2 + p210_chroma_row_bytes(width)) * height;
+        default: return (size_t)width * height * f.bytes_per_pixel;
+    }
+}
+
+// The matrix and range the tools assume for Y'CbCr input
+inline YCbCrKeyer ycbcr_keyer(const KeyerParams& params) {
+    return YCbCrKeyer(params, YCBCR_REC709, YCBCR_VIDEO_RANGE);
+}
+
+// Row y of a v210 frame, as words
+inline const uint32_t* v210_row(const uint8_t* frame, int width, int y) {
+    return reinterpret_cast<const uint32_t*>(frame + (size_t)y * v210_row_bytes(width));
+}
+
+// Row y of a p210le frame's luma and interleaved chroma planes
+inline const uint16_t* p210_luma_row(const uint8_t* frame, int width, int y) {
+    return reinterpret_cast<const uint16_t*>(frame + (size_t)y * width * 2);
+}
+
+inline const uint16_t* p210_chroma_row(const uint8_t* frame, int width, int height, int y) {
+    return reinterpret_cast<const uint16_t*>(frame + (size_t)height * width * 2 +
+                                             (size_t)y * p210_chroma_row_bytes(width));
+}
+
+// Key row y of a v210 or p210le frame without decoding it to RGB
+inline void key_ycbcr_row(const YCbCrKeyer& keyer, int format, const uint8_t* frame, int width,
+                          int height, int y, float* alpha) {
+    if (format == IN_V210) {
+        keyer.key_v210_row(v210_row(frame, width, y), width, alpha);
+    } else {
+        keyer.key_p210_row(p210_luma_row(frame, width, y), p210_chroma_row(frame, width, height, y),
+                           width, alpha);
+    }
+}
+
+template <typename T>
+inline T load(const uint8_t* p) {
+    T v;
+    memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+template <typename T>
+inline void store(uint8_t* p, T v) {
+    memcpy(p, &v, sizeof(T));
+}
+
+// Convert row y of the input frame to planar float RGB
+inline void decode_row(int format, const uint8_t* frame, int width, int height, int y,
+                       float* r, float* g, float* b) {
+    const size_t plane = (size_t)width * height;
+    switch (format) {
+        case IN_RGB24: {
+            const uint8_t* p = frame + (size_t)y * width * 3;
+            for (int x = 0; x < width; x++, p += 3) {
+                r[x] = p[0] / 255.0f; g[x] = p[1] / 255.0f; b[x] = p[2] / 255.0f;
+            }
+            break;
+        }
+        case IN_RGB48LE:
+        case IN_RGBA64LE: {
+            int step = (format == IN_RGB48LE) ? 6 : 8;
+            const uint8_t* p = frame + (size_t)y * width * step;
+            for (int x = 0; x < width; x++, p += step) {
+                r[x] = load<uint16_t>(p) / 65535.0f;
+                g[x] = load<uint16_t>(p + 2) / 65535.0f;
+                b[x] = load<uint16_t>(p + 4) / 65535.0f;
+            }
+            break;
+        }
+        case IN_GBRP16LE: {
+            const uint8_t* gp = frame + (size_t)y * width * 2;
+            const uint8_t* bp = gp + plane * 2;
+            const uint8_t* rp = bp + plane * 2;
+            for (int x = 0; x < width; x++) {
+                g[x] = load<uint16_t>(gp + x * 2) / 65535.0f;
+                b[x] = load<uint16_t>(bp + x * 2) / 65535.0f;
+                r[x] = load<uint16_t>(rp + x * 2) / 65535.0f;
+            }
+            break;
+        }
+        case IN_RGBF32LE: {
+            const uint8_t* p = frame + (size_t)y * width * 12;
+            for (int x = 0; x < width; x++, p += 12) {
+                r[x] = load<float>(p); g[x] = load<float>(p + 4); b[x] = load<float>(p + 8);
+            }
+            break;
+        }
+        case IN_GBRPF32LE: {
+            const uint8_t* gp = frame + (size_t)y * width * 4;
+            memcpy(g, gp, width * 4);
+            memcpy(b, gp + plane * 4, width * 4);
+            memcpy(r, gp + plane * 8, width * 4);
+            break;
+        }
+        case IN_V210:
+        case IN_P210LE: {
+            // Only the matrix and range of the keyer are used
+            static const YCbCrKeyer decoder = ycbcr_keyer(KeyerParams());
+            if (format == IN_V210) {
+                decoder.decode_v210_row(v210_row(frame, width, y), width, r, g, b);
+            } else {
+                decoder.decode_p210_row(p210_luma_row(frame, width, y),
+                                        p210_chroma_row(frame, width, height, y), width, r, g, b);
+            }
+            break;
+        }
+    }
+}
+
+template <typename T>
+inline T quantize(float v, float scale) {
+    v = std::max(0.0f, std::min(1.0f, v));
+    return (T)(v * scale + 0.5f);
+}
+
+inline void encode_row(int format, uint8_t* frame, int width, int y,
+                       const float* r, const float* g, const float* b, const float* a) {
+    switch (format) {
+        case OUT_RGBA: {
+            uint8_t* p = frame + (size_t)y * width * 4;
+            for (int x = 0; x < width; x++, p += 4) {
+                p[0] = quantize<uint8_t>(r[x], 255.0f);
+                p[1] = quantize<uint8_t>(g[x], 255.0f);
+                p[2] = quantize<uint8_t>(b[x], 255.0f);
+                p[3] = quantize<uint8_t>(a[x], 255.0f);
+            }
+            break;
+        }
+        case OUT_RGBA64LE: {
+            uint8_t* p = frame + (size_t)y * width * 8;
+            for (int x = 0; x < width; x++, p += 8) {
+                store(p, quantize<uint16_t>(r[x], 65535.0f));
+                store(p + 2, quantize<uint16_t>(g[x], 65535.0f));
+                store(p + 4, quantize<uint16_t>(b[x], 65535.0f));
+                store(p + 6, quantize<uint16_t>(a[x], 65535.0f));
+            }
+            break;
+        }
+        case OUT_RGBAF32LE: {
+            uint8_t* p = frame + (size_t)y * width * 16;
+            for (int x = 0; x < width; x++, p += 16) {
+                store(p, r[x]); store(p + 4, g[x]); store(p + 8, b[x]); store(p + 12, a[x]);
+            }
+            break;
+        }
+        case OUT_GRAY: {
+            uint8_t* p = frame + (size_t)y * width;
+            for (int x = 0; x < width; x++) p[x] = quantize<uint8_t>(a[x], 255.0f);
+            break;
+        }
+        case OUT_GRAY16LE: {
+            uint8_t* p = frame + (size_t)y * width * 2;
+            for (int x = 0; x < width; x++) store(p + x * 2, quantize<uint16_t>(a[x], 65535.0f));
+            break;
+        }
+        case OUT_GRAYF32LE:
+            memcpy(frame + (size_t)y * width * 4, a, width * 4);
+            break;
+    }
+}
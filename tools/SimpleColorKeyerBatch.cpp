@@ -0,0 +1,563 @@
+// SimpleColorKeyerBatch.cpp - Key a sequence of raw frame files
+//
+//   SimpleColorKeyerBatch -s 3840x2160 -i rgb48le -o grayf32le
+//       --in plate.%04d.raw --out matte.%04d.raw --frames 1001-1240 --key 0.1,0.7,0.2
+//
+// The main thread keeps up to --depth frames in flight through an I/O
+// backend (BatchIO.h) while a pool of worker threads keys the frames whose
+// reads have completed. '--io both' runs the sequence once with each
+// backend and prints a comparison. With --shard-dir, several processes
+// split the range through claim files (BatchShards.h) and resume where a
+// killed job stopped. With --matte, mattes are written as compact .sckm
+// files (SimpleColorKeyerMatte.h) instead of raw frames. With --incremental,
+// frames are keyed in order by one IncrementalKeyer that re-keys only the
+// tiles that changed since the previous frame. With --plate, each pixel is
+// keyed against its value in a clean plate (SimpleColorKeyerCleanPlate).
+#include "KeyerToolArgs.h"
+#include "RawFrameFormats.h"
+#include "BatchIO.h"
+#include "BatchShards.h"
+#include "IncrementalKeyer.h"
+#include "../SimpleColorKeyerMatte.h"
+#include <fcntl.h>
+#include <chrono>
+#include <map>
+#include <string>
+
+namespace {
+
+struct BatchOptions {
+    KeyerParams params;
+    int width = 0, height = 0;
+    const FormatName* in_fmt = find_format(in_formats, "rgb48le");
+    const FormatName* out_fmt = find_format(out_formats, "grayf32le");
+    std::string in_pattern, out_pattern;
+    int first = 0, last = -1;
+    int depth = 8;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    int io_threads = 4;
+    bool cold = false;
+    std::string shard_dir;      // empty: key the whole range in this process
+    int chunk = 10;
+    int stale_seconds = 120;
+    bool matte = false;         // write .sckm files instead of raw frames
+    MatteEncoding matte_encoding = MATTE_UNORM16;
+    bool incremental = false;   // key in frame order, reusing unchanged tiles
+    int tile = 64;
+    std::string plate_path;     // rgbf32le clean plate used as per-pixel key color
+    std::vector<float> plate;   // loaded plate, planar R, G, B
+};
+
+// Load an rgbf32le plate into opt.plate as three planes
+bool load_plate(BatchOptions& opt) {
+    const size_t pixels = (size_t)opt.width * opt.height;
+    std::vector<uint8_t> raw(pixels * 12);
+    FILE* f = fopen(opt.plate_path.c_str(), "rb");
+    if (!f) {
+        perror(opt.plate_path.c_str());
+        return false;
+    }
+    size_t got = fread(raw.data(), 1, raw.size(), f);
+    bool extra = fgetc(f) != EOF;
+    fclose(f);
+    if (got != raw.size() || extra) {
+        fprintf(stderr, "%s: expected a %dx%d rgbf32le plate (%zu bytes)\n",
+                opt.plate_path.c_str(), opt.width, opt.height, raw.size());
+        return false;
+    }
+    opt.plate.resize(pixels * 3);
+    for (int y = 0; y < opt.height; y++) {
+        const size_t at = (size_t)y * opt.width;
+        decode_row(IN_RGBF32LE, raw.data(), opt.width, opt.height, y,
+                   &opt.plate[at], &opt.plate[pixels + at], &opt.plate[2 * pixels + at]);
+    }
+    return true;
+}
+
+// Bytes of the output buffer for one frame
+size_t output_capacity(const BatchOptions& opt) {
+    if (opt.matte) {
+        return kMatteHeaderSize + ((size_t)opt.height + 1) * sizeof(uint64_t) +
+               (size_t)opt.height * matte_row_bound(opt.width);
+    }
+    return (size_t)opt.width * opt.height * opt.out_fmt->bytes_per_pixel;
+}
+
+struct BatchStats {
+    int frames = 0;
+    int failed = 0;
+    int skipped = 0;            // already complete on disk (shard mode)
+    double seconds = 0.0;
+    double key_seconds = 0.0;   // summed over worker threads
+    uint64_t bytes_read = 0, bytes_written = 0;
+    IncrementalKeyer::Stats tiles;  // --incremental only
+    double tile_speedup = 0.0;
+};
+
+std::string frame_path(const std::string& pattern, int frame) {
+    char buf[4096];
+    snprintf(buf, sizeof(buf), pattern.c_str(), frame);
+    return buf;
+}
+
+// One frame in flight: its buffers never move, so they can be registered
+struct Slot {
+    int frame = 0;
+    uint64_t seq = 0;           // read order, for --incremental
+    std::string temp_path;      // output is renamed into place once written
+    uint8_t* in = nullptr;
+    uint8_t* out = nullptr;
+    IoRequest read, write;
+};
+
+// Frames whose reads have completed. An ordered queue hands slots out in
+// Slot::seq order, however the reads complete.
+class KeyQueue {
+public:
+    explicit KeyQueue(bool ordered) : ordered_(ordered) {}
+
+    void push(Slot* s) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ordered_) pending_[s->seq] = s;
+        else slots_.push_back(s);
+        cond_.notify_all();
+    }
+    // The read with sequence number 'seq' failed; don't wait for it
+    void skip(uint64_t seq) {
+        if (!ordered_) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_[seq] = nullptr;
+        cond_.notify_all();
+    }
+    // Returns nullptr once closed and drained
+    Slot* pop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (ordered_) {
+            for (;;) {
+                cond_.wait(lock, [this] {
+                    return closed_ || (!pending_.empty() && pending_.begin()->first == next_seq_);
+                });
+                if (pending_.empty() || pending_.begin()->first != next_seq_) return nullptr;
+                Slot* s = pending_.begin()->second;
+                pending_.erase(pending_.begin());
+                next_seq_++;
+                if (s) return s;
+            }
+        }
+        cond_.wait(lock, [this] { return closed_ || !slots_.empty(); });
+        if (slots_.empty()) return nullptr;
+        Slot* s = slots_.front();
+        slots_.pop_front();
+        return s;
+    }
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        cond_.notify_all();
+    }
+private:
+    const bool ordered_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Slot*> slots_;
+    std::map<uint64_t, Slot*> pending_;
+    uint64_t next_seq_ = 0;
+    bool closed_ = false;
+};
+
+// True when the raw output format carries the input RGB through
+bool output_has_rgb(int format) {
+    return format == OUT_RGBA || format == OUT_RGBA64LE || format == OUT_RGBAF32LE;
+}
+
+void* alloc_buffer(size_t bytes) {
+    // Page-aligned so the kernel can pin it as a registered buffer
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? nullptr : p;
+}
+
+BatchStats run_batch(const BatchOptions& opt, const char* io_name, FrameSource& source) {
+    BatchStats stats;
+    const int w = opt.width, h = opt.height;
+    const size_t in_size = input_frame_bytes(*opt.in_fmt, w, h);
+    const size_t out_size = output_capacity(opt);
+    const int total = opt.last - opt.first + 1;
+    const std::string temp_suffix = ".tmp." + std::to_string(getpid());
+
+    std::vector<Slot> slots(std::min(opt.depth, total));
+    std::vector<iovec> buffers;
+    for (Slot& s : slots) {
+        s.in = static_cast<uint8_t*>(alloc_buffer(in_size));
+        s.out = static_cast<uint8_t*>(alloc_buffer(out_size));
+        if (!s.in || !s.out) {
+            fprintf(stderr, "Out of memory allocating frame buffers\n");
+            exit(1);
+        }
+        s.read.buf = s.in;
+        s.read.size = in_size;
+        s.read.buf_index = (int)buffers.size();
+        buffers.push_back(iovec{ s.in, in_size });
+        s.write.write = true;
+        s.write.buf = s.out;
+        s.write.size = out_size;
+        s.write.buf_index = (int)buffers.size();
+        buffers.push_back(iovec{ s.out, out_size });
+        s.read.user = s.write.user = &s;
+    }
+
+    std::unique_ptr<BatchIoBackend> backend;
+#ifdef __linux__
+    if (!strcmp(io_name, "io_uring")) {
+        std::unique_ptr<UringBackend> uring(new UringBackend());
+        // Reads and writes of every slot can be in flight at once
+        if (uring->init((unsigned)slots.size() * 2, buffers)) {
+            if (!uring->fixed_buffers()) {
+                fprintf(stderr, "io_uring: buffer registration failed (RLIMIT_MEMLOCK?), "
+                                "using unregistered buffers\n");
+            }
+            backend = std::move(uring);
+        } else {
+            // EOPNOTSUPP: buffers could not be registered and the kernel
+            // predates unregistered READ / WRITE
+            fprintf(stderr, "io_uring unavailable (%s), falling back to threads\n", strerror(errno));
+        }
+    }
+#endif
+    if (!backend) backend.reset(new ThreadPoolBackend(opt.io_threads));
+
+    KeyQueue to_key(opt.incremental);
+    std::atomic<int64_t> key_ns(0);
+    std::atomic<int> failed(0);
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Write the keyed frame in s->out to a temp file
+    auto submit_write = [&](Slot* s) {
+        s->temp_path = frame_path(opt.out_pattern, s->frame) + temp_suffix;
+        s->write.fd = open(s->temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (s->write.fd < 0) {
+            fprintf(stderr, "%s: %s\n", s->temp_path.c_str(), strerror(errno));
+            s->write.error = errno;
+            failed++;
+        }
+        // A failed open still goes through the backend, which hands
+        // the slot back to the main thread with EBADF
+        backend->submit(&s->write);
+    };
+
+    std::unique_ptr<IncrementalKeyer> incremental;
+    std::vector<std::thread> workers;
+    if (opt.incremental) {
+        // One thread takes frames in order; IncrementalKeyer spreads each
+        // frame's changed tiles over opt.threads threads
+        incremental.reset(new IncrementalKeyer(w, h, opt.in_fmt->id, opt.in_fmt->bytes_per_pixel, opt.tile));
+        if (!opt.plate.empty()) {
+            const size_t plane = (size_t)w * h;
+            incremental->set_plate(&opt.plate[0], &opt.plate[plane], &opt.plate[2 * plane]);
+        }
+        workers.emplace_back([&] {
+            const bool rgb = !opt.matte && output_has_rgb(opt.out_fmt->id);
+            std::vector<float> r(w), g(w), b(w);
+            std::vector<uint8_t> encoded;
+            while (Slot* s = to_key.pop()) {
+                auto t0 = std::chrono::steady_clock::now();
+                incremental->key_frame(s->in, opt.params, opt.threads);
+                const float* alpha = incremental->alpha();
+                if (opt.matte) {
+                    encode_matte_file(alpha, w, h, opt.matte_encoding, encoded);
+                    memcpy(s->out, encoded.data(), encoded.size());
+                    s->write.size = encoded.size();
+                } else {
+                    for (int y = 0; y < h; y++) {
+                        if (rgb) decode_row(opt.in_fmt->id, s->in, w, h, y, r.data(), g.data(), b.data());
+                        encode_row(opt.out_fmt->id, s->out, w, y, r.data(), g.data(), b.data(),
+                                   alpha + (size_t)y * w);
+                    }
+                }
+                key_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - t0).count();
+                submit_write(s);
+            }
+        });
+    }
+    for (int t = 0; t < opt.threads && !opt.incremental; t++) {
+        workers.emplace_back([&] {
+            std::vector<float> r(w), g(w), b(w), a(w);
+            std::vector<float> matte(opt.matte ? (size_t)w * h : 0);
+            std::vector<uint8_t> encoded;
+            // Y'CbCr input is keyed from the code values, and decoded only
+            // for RGB output or a plate
+            const bool ycbcr = is_ycbcr(opt.in_fmt->id) && opt.plate.empty();
+            const bool rgb = !ycbcr || (!opt.matte && output_has_rgb(opt.out_fmt->id));
+            const YCbCrKeyer ycbcr_keys = ycbcr_keyer(opt.params);
+            while (Slot* s = to_key.pop()) {
+                auto t0 = std::chrono::steady_clock::now();
+                for (int y = 0; y < h; y++) {
+                    if (rgb) decode_row(opt.in_fmt->id, s->in, w, h, y, r.data(), g.data(), b.data());
+                    float* alpha = opt.matte ? matte.data() + (size_t)y * w : a.data();
+                    if (ycbcr) {
+                        key_ycbcr_row(ycbcr_keys, opt.in_fmt->id, s->in, w, h, y, alpha);
+                    } else if (!opt.plate.empty()) {
+                        const size_t at = (size_t)y * w, plane = (size_t)w * h;
+                        key_row_plate(opt.params, r.data(), g.data(), b.data(), &opt.plate[at],
+                                      &opt.plate[plane + at], &opt.plate[2 * plane + at], alpha, w);
+                    } else {
+                        key_row(opt.params, r.data(), g.data(), b.data(), alpha, w);
+                    }
+                    if (!opt.matte) {
+                        encode_row(opt.out_fmt->id, s->out, w, y, r.data(), g.data(), b.data(), a.data());
+                    }
+                }
+                if (opt.matte) {
+                    encode_matte_file(matte.data(), w, h, opt.matte_encoding, encoded);
+                    memcpy(s->out, encoded.data(), encoded.size());
+                    s->write.size = encoded.size();
+                }
+                key_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - t0).count();
+                submit_write(s);
+            }
+        });
+    }
+
+    // Start the read of the next frame that exists; returns false when done
+    uint64_t next_seq = 0;
+    auto start_read = [&](Slot& s) {
+        while (source.next(s.frame)) {
+            std::string path = frame_path(opt.in_pattern, s.frame);
+            s.read.fd = open(path.c_str(), O_RDONLY);
+            if (s.read.fd < 0) {
+                fprintf(stderr, "%s: %s\n", path.c_str(), strerror(errno));
+                failed++;
+                source.finished(s.frame, false);
+                continue;
+            }
+            if (opt.cold) posix_fadvise(s.read.fd, 0, 0, POSIX_FADV_DONTNEED);
+            s.seq = next_seq++;
+            backend->submit(&s.read);
+            return true;
+        }
+        return false;
+    };
+
+    int in_flight = 0;
+    for (Slot& s : slots) {
+        if (start_read(s)) in_flight++;
+    }
+
+    while (in_flight > 0) {
+        IoRequest* req = backend->wait();
+        if (!req) {
+            perror("io wait");
+            exit(1);
+        }
+        Slot& s = *static_cast<Slot*>(req->user);
+        if (!req->write) {
+            close(req->fd);
+            if (req->error) {
+                fprintf(stderr, "frame %d: read failed: %s\n", s.frame, strerror(req->error));
+                failed++;
+                to_key.skip(s.seq);
+                source.finished(s.frame, false);
+            } else {
+                stats.bytes_read += req->done;
+                to_key.push(&s);
+                continue;
+            }
+        } else {
+            if (req->fd >= 0) {
+                if (opt.cold) posix_fadvise(req->fd, 0, 0, POSIX_FADV_DONTNEED);
+                close(req->fd);
+                bool ok = !req->error;
+                if (!ok) {
+                    fprintf(stderr, "frame %d: write failed: %s\n", s.frame, strerror(req->error));
+                    failed++;
+                } else if (rename(s.temp_path.c_str(), frame_path(opt.out_pattern, s.frame).c_str()) != 0) {
+                    fprintf(stderr, "frame %d: rename failed: %s\n", s.frame, strerror(errno));
+                    failed++;
+                    ok = false;
+                } else {
+                    stats.bytes_written += req->done;
+                    stats.frames++;
+                }
+                if (!ok) unlink(s.temp_path.c_str());
+                source.finished(s.frame, ok);
+            } else {
+                source.finished(s.frame, false);
+            }
+        }
+        source.tick();
+        // The slot is free again
+        in_flight--;
+        if (start_read(s)) in_flight++;
+    }
+
+    to_key.close();
+    for (std::thread& t : workers) t.join();
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.key_seconds = key_ns.load() * 1e-9;
+    stats.failed = failed.load();
+    stats.skipped = source.skipped();
+    if (incremental) {
+        stats.tiles = incremental->stats();
+        stats.tile_speedup = incremental->estimated_speedup();
+    }
+
+    for (Slot& s : slots) {
+        munmap(s.in, in_size);
+        munmap(s.out, out_size);
+    }
+    return stats;
+}
+
+void report(const char* backend, const BatchStats& s, int threads) {
+    double mb = (s.bytes_read + s.bytes_written) / (1024.0 * 1024.0);
+    printf("  %-9s %6d frames  %7.2f s  %7.2f fps  %8.1f MB/s  key busy %5.1f%%%s\n",
+           backend, s.frames, s.seconds, s.frames / s.seconds, mb / s.seconds,
+           100.0 * s.key_seconds / (s.seconds * threads),
+           s.failed ? "  (with failures)" : "");
+    if (s.skipped) printf("  %-9s %6d frames already complete, skipped\n", "", s.skipped);
+    if (s.tiles.tiles) {
+        printf("  %-9s tiles reused %.1f%% (%llu of %llu)", "",
+               100.0 * s.tiles.reused / s.tiles.tiles, (unsigned long long)s.tiles.reused,
+               (unsigned long long)s.tiles.tiles);
+        if (s.tile_speedup > 0.0) {
+            printf(", speedup over full keys %.1fx (estimate, from %d full frame%s)",
+                   s.tile_speedup, s.tiles.full_frames, s.tiles.full_frames == 1 ? "" : "s");
+        }
+        printf("\n");
+    }
+}
+
+void usage() {
+    fprintf(stderr,
+        "Usage: SimpleColorKeyerBatch -s WxH --in pattern --out pattern --frames first-last\n"
+        "                             [-i fmt] [-o fmt] [--io uring|threads|both] [--depth n]\n"
+        "                             [--threads n] [--io-threads n] [--cold] [keyer options]\n"
+        "  --in / --out         printf-style frame paths, e.g. plate.%%04d.raw\n"
+        "  -i fmt               Input pixel format (default rgb48le; v210 and p210le are\n"
+        "                       Rec.709 video range)\n"
+        "  -o fmt               Output pixel format (default grayf32le)\n"
+        "  --io b               I/O backend (default uring, falls back to threads)\n"
+        "  --depth n            Frames in flight (default 8)\n"
+        "  --threads n          Keying threads (default: all CPUs)\n"
+        "  --io-threads n       Threads for the pread/pwrite backend (default 4)\n"
+        "  --cold               Drop frames from the page cache around I/O (benchmarking)\n"
+        "  --shard-dir d        Share the range with other processes through claim files\n"
+        "                       in d; finished frames are skipped on restart\n"
+        "  --chunk n            Frames per claimed chunk (default 10)\n"
+        "  --stale s            Take over claims not refreshed for s seconds (default 120)\n"
+        "  --matte e            Write .sckm matte files (unorm16 | half) instead of -o frames\n"
+        "  --incremental        Key frames in order, re-keying only tiles whose input changed\n"
+        "  --tile n             Tile size for --incremental (default 64)\n"
+        "  --plate f            Key each pixel against an rgbf32le clean plate instead of --key\n");
+    print_keyer_usage(stderr);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BatchOptions opt;
+    std::string io = "uring";
+
+    for (int i = 1; i < argc; i++) {
+        if (parse_keyer_arg(argc, argv, i, opt.params)) continue;
+        if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &opt.width, &opt.height) != 2) opt.width = 0;
+        } else if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+            opt.in_fmt = find_format(in_formats, argv[++i]);
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            opt.out_fmt = find_format(out_formats, argv[++i]);
+        } else if (!strcmp(argv[i], "--in") && i + 1 < argc) {
+            opt.in_pattern = argv[++i];
+        } else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+            opt.out_pattern = argv[++i];
+        } else if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d-%d", &opt.first, &opt.last) != 2) opt.last = -1;
+        } else if (!strcmp(argv[i], "--io") && i + 1 < argc) {
+            io = argv[++i];
+        } else if (!strcmp(argv[i], "--depth") && i + 1 < argc) {
+            opt.depth = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            opt.threads = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--io-threads") && i + 1 < argc) {
+            opt.io_threads = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--cold")) {
+            opt.cold = true;
+        } else if (!strcmp(argv[i], "--shard-dir") && i + 1 < argc) {
+            opt.shard_dir = argv[++i];
+        } else if (!strcmp(argv[i], "--chunk") && i + 1 < argc) {
+            opt.chunk = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--matte") && i + 1 < argc) {
+            const char* e = argv[++i];
+            opt.matte = true;
+            if (!strcmp(e, "half")) opt.matte_encoding = MATTE_HALF;
+            else if (strcmp(e, "unorm16")) opt.width = 0;   // reject below
+        } else if (!strcmp(argv[i], "--stale") && i + 1 < argc) {
+            opt.stale_seconds = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--incremental")) {
+            opt.incremental = true;
+        } else if (!strcmp(argv[i], "--tile") && i + 1 < argc) {
+            opt.tile = std::max(8, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--plate") && i + 1 < argc) {
+            opt.plate_path = argv[++i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (opt.width <= 0 || opt.height <= 0 || !opt.in_fmt || !opt.out_fmt ||
+        opt.in_pattern.empty() || opt.out_pattern.empty() || opt.last < opt.first ||
+        (io != "uring" && io != "threads" && io != "both") ||
+        (!opt.shard_dir.empty() && io == "both")) {
+        usage();
+        return 2;
+    }
+    if (opt.incremental && is_ycbcr(opt.in_fmt->id)) {
+        fprintf(stderr, "--incremental needs an RGB input format\n");
+        return 2;
+    }
+    if (!opt.plate_path.empty() && !load_plate(opt)) return 1;
+
+    printf("SimpleColorKeyerBatch: frames %d-%d, %dx%d %s -> %s, depth %d, %d key threads\n",
+           opt.first, opt.last, opt.width, opt.height, opt.in_fmt->name,
+           opt.matte ? (opt.matte_encoding == MATTE_HALF ? "sckm (half)" : "sckm (unorm16)")
+                     : opt.out_fmt->name,
+           opt.depth, opt.threads);
+
+    if (!opt.shard_dir.empty()) {
+        // Matte files vary in size; any existing (renamed-into-place) file is complete
+        const size_t out_size = opt.matte ? 0 : output_capacity(opt);
+        ShardSource shards(opt.shard_dir, opt.first, opt.last, opt.chunk, opt.stale_seconds,
+                           opt.out_pattern, out_size);
+        const char* backend = io == "threads" ? "threads" : "io_uring";
+        BatchStats s = run_batch(opt, backend, shards);
+        printf("  shard %s: %d chunks completed, %d taken over from stale claims, %d failed\n",
+               shards.owner().c_str(), shards.chunks_completed(), shards.chunks_taken_over(),
+               shards.chunks_failed());
+        report(backend, s, opt.threads);
+
+        char line[256];
+        snprintf(line, sizeof(line), "keyed %d skipped %d failed %d chunks %d in %.2fs (%.2f fps)",
+                 s.frames, s.skipped, s.failed, shards.chunks_completed(), s.seconds,
+                 s.seconds > 0.0 ? s.frames / s.seconds : 0.0);
+        shards.log_progress(line);
+        return s.failed ? 1 : 0;
+    }
+
+    bool failed = false;
+    if (io == "uring" || io == "both") {
+        RangeSource range(opt.first, opt.last);
+        BatchStats s = run_batch(opt, "io_uring", range);
+        report("io_uring", s, opt.threads);
+        failed |= s.failed != 0;
+    }
+    if (io == "threads" || io == "both") {
+        RangeSource range(opt.first, opt.last);
+        BatchStats s = run_batch(opt, "threads", range);
+        report("threads", s, opt.threads);
+        failed |= s.failed != 0;
+    }
+    return failed ? 1 : 0;
+}
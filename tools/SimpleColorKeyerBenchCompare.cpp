@@ -0,0 +1,191 @@
+// SimpleColorKeyerBenchCompare.cpp - Detect regressions between benchmark runs
+//
+// Compares two SimpleColorKeyerMicroBench JSON files case by case (method,
+// row length, expansion knobs, input distribution) using the per-repetition
+// samples:
+//
+//   - a two-sided Mann-Whitney U test says whether the two sets of timings
+//     differ by more than run-to-run noise
+//   - a bootstrap confidence interval of the ratio of medians says by how
+//     much
+//
+// A case is a regression when the test is significant at --alpha, the
+// median slowed down by more than --threshold percent and the whole
+// confidence interval lies above 1. The exit status is 1 if any case
+// regressed, so the tool can gate a release:
+//
+//   SimpleColorKeyerMicroBench --reps 15 --json baseline.json    (old build)
+//   SimpleColorKeyerMicroBench --reps 15 --json current.json     (new build)
+//   SimpleColorKeyerBenchCompare baseline.json current.json --threshold 3
+#include "MiniJson.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+namespace {
+
+struct Case {
+    std::string key;            // method, row length, expansion, distribution
+    std::vector<double> samples;
+};
+
+bool load_cases(const char* path, std::vector<Case>& cases) {
+    JsonValue root;
+    if (!read_json_file(path, root)) return false;
+    const JsonValue& results = root["results"];
+    if (results.type != JsonValue::ARRAY) {
+        fprintf(stderr, "%s: no \"results\" array\n", path);
+        return false;
+    }
+    for (const JsonValue& r : results.array) {
+        Case c;
+        char key[256];
+        snprintf(key, sizeof(key), "%-14s %6d %-3s %-10s", r["function"].string.c_str(),
+                 (int)r["row_length"].number, r["expansion"].boolean ? "exp" : "-",
+                 r["distribution"].string.c_str());
+        c.key = key;
+        for (const JsonValue& s : r["samples"].array) c.samples.push_back(s.number);
+        if (c.samples.empty()) {
+            fprintf(stderr, "%s: case without samples (written before version 2?)\n", path);
+            return false;
+        }
+        cases.push_back(c);
+    }
+    return true;
+}
+
+double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n & 1 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+// Two-sided p-value of the Mann-Whitney U test, normal approximation with
+// tie and continuity correction
+double mann_whitney_p(const std::vector<double>& a, const std::vector<double>& b) {
+    const size_t n1 = a.size(), n2 = b.size(), n = n1 + n2;
+    std::vector<std::pair<double, int>> all;
+    for (double x : a) all.push_back(std::make_pair(x, 0));
+    for (double x : b) all.push_back(std::make_pair(x, 1));
+    std::sort(all.begin(), all.end());
+
+    // Midranks, and the tie correction term sum(t^3 - t)
+    double rank_sum_a = 0.0, ties = 0.0;
+    for (size_t i = 0; i < n;) {
+        size_t j = i;
+        while (j < n && all[j].first == all[i].first) j++;
+        double rank = 0.5 * (i + 1 + j);
+        for (size_t k = i; k < j; k++) {
+            if (all[k].second == 0) rank_sum_a += rank;
+        }
+        double t = (double)(j - i);
+        ties += t * t * t - t;
+        i = j;
+    }
+    const double u = rank_sum_a - n1 * (n1 + 1) / 2.0;
+    const double mean = n1 * n2 / 2.0;
+    const double var = n1 * n2 / 12.0 * ((n + 1) - ties / (n * (n - 1.0)));
+    if (var <= 0.0) return 1.0;
+    const double z = (std::fabs(u - mean) - 0.5) / std::sqrt(var);
+    return std::min(1.0, std::erfc(std::max(0.0, z) / std::sqrt(2.0)));
+}
+
+// Percentile bootstrap interval of median(b) / median(a)
+void bootstrap_ratio(const std::vector<double>& a, const std::vector<double>& b, int resamples,
+                     double confidence, uint32_t seed, double& lo, double& hi) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> pick_a(0, a.size() - 1), pick_b(0, b.size() - 1);
+    std::vector<double> ra(a.size()), rb(b.size()), ratios(resamples);
+    for (int i = 0; i < resamples; i++) {
+        for (double& x : ra) x = a[pick_a(rng)];
+        for (double& x : rb) x = b[pick_b(rng)];
+        ratios[i] = median(rb) / median(ra);
+    }
+    std::sort(ratios.begin(), ratios.end());
+    const double tail = (1.0 - confidence) / 2.0;
+    lo = ratios[(size_t)(tail * (resamples - 1))];
+    hi = ratios[(size_t)((1.0 - tail) * (resamples - 1))];
+}
+
+void usage() {
+    fprintf(stderr,
+        "Usage: SimpleColorKeyerBenchCompare BASELINE.json CURRENT.json [--threshold pct]\n"
+        "                                    [--alpha a] [--resamples n] [--all]\n"
+        "  --threshold pct      Slowdown that counts as a regression (default 5)\n"
+        "  --alpha a            Significance level of the Mann-Whitney test (default 0.01)\n"
+        "  --resamples n        Bootstrap resamples (default 2000)\n"
+        "  --all                List every case, not just significant changes\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* paths[2] = { nullptr, nullptr };
+    double threshold = 5.0, alpha = 0.01;
+    int resamples = 2000;
+    bool all = false;
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--threshold") && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--alpha") && i + 1 < argc) {
+            alpha = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--resamples") && i + 1 < argc) {
+            resamples = std::max(100, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--all")) {
+            all = true;
+        } else if (argv[i][0] != '-' && positional < 2) {
+            paths[positional++] = argv[i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (positional != 2 || alpha <= 0.0 || alpha >= 1.0) {
+        usage();
+        return 2;
+    }
+
+    std::vector<Case> base, current;
+    if (!load_cases(paths[0], base) || !load_cases(paths[1], current)) return 2;
+
+    int regressions = 0, improvements = 0, compared = 0;
+    printf("%-14s %6s %-3s %-10s  %9s %9s  %7s  %-17s %8s\n", "method", "length", "exp", "input",
+           "base ns", "new ns", "change", "95% CI of ratio", "p");
+    for (const Case& b : base) {
+        auto it = std::find_if(current.begin(), current.end(), [&](const Case& c) { return c.key == b.key; });
+        if (it == current.end()) continue;
+        const Case& c = *it;
+        compared++;
+
+        const double mb = median(b.samples), mc = median(c.samples);
+        const double change = 100.0 * (mc / mb - 1.0);
+        const double p = mann_whitney_p(b.samples, c.samples);
+        double lo, hi;
+        bootstrap_ratio(b.samples, c.samples, resamples, 0.95, 12345u + compared, lo, hi);
+
+        const bool significant = p < alpha;
+        const char* verdict = "";
+        if (significant && change > threshold && lo > 1.0) {
+            verdict = "REGRESSION";
+            regressions++;
+        } else if (significant && change < -threshold && hi < 1.0) {
+            verdict = "faster";
+            improvements++;
+        } else if (!all) {
+            continue;
+        }
+        printf("%s  %9.3f %9.3f  %+6.1f%%  [%.3f, %.3f]  %8.2g  %s\n", b.key.c_str(), mb, mc, change,
+               lo, hi, p, verdict);
+    }
+
+    printf("%d cases compared, %d regressions, %d improvements (threshold %.1f%%, alpha %g)\n",
+           compared, regressions, improvements, threshold, alpha);
+    if (compared == 0) {
+        fprintf(stderr, "No cases in common between %s and %s\n", paths[0], paths[1]);
+        return 2;
+    }
+    return regressions ? 1 : 0;
+}
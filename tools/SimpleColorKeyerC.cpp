@@ -0,0 +1,134 @@
+// SimpleColorKeyerC.cpp - Implementation of the C ABI (SimpleColorKeyerC.h)
+//
+// Rows are keyed in parallel on a shared TaskPool. Float32 rows with packed
+// channels go straight to key_row(); anything else (float16, interleaved
+// or strided) is gathered into per-thread scratch rows first.
+#ifndef SCK_C_BUILD      // also set by setup.py for the Python module's own sources
+#define SCK_C_BUILD
+#endif
+#include "../SimpleColorKeyerC.h"
+#include "../SimpleColorKeyerArena.h"
+#include "../SimpleColorKeyerCore.h"
+#include "../SimpleColorKeyerMatte.h"
+#include "../SimpleColorKeyerTasks.h"
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+KeyerParams to_keyer_params(const sck_params& s) {
+    KeyerParams p;
+    for (int c = 0; c < 3; c++) p.key_color[c] = s.key_color[c];
+    p.variance = s.tolerance;
+    p.keying_method = s.method;
+    p.gain = s.gain;
+    p.invert = s.invert != 0;
+    p.range_red = s.red;
+    p.range_green = s.green;
+    p.range_blue = s.blue;
+    p.range_yellow = s.yellow;
+    p.range_magenta = s.magenta;
+    p.range_cyan = s.cyan;
+    return p;
+}
+
+// Row y of one channel as float: a pointer into the plane itself when it
+// is packed float32, otherwise 'scratch' filled with the converted samples
+const float* channel_row(sck_type type, const sck_plane& plane, int y, int width, float* scratch) {
+    const uint8_t* p = static_cast<const uint8_t*>(plane.data) + (ptrdiff_t)y * plane.y_stride;
+    if (type == SCK_FLOAT32) {
+        if (plane.x_stride == sizeof(float)) return reinterpret_cast<const float*>(p);
+        for (int x = 0; x < width; x++, p += plane.x_stride) memcpy(&scratch[x], p, sizeof(float));
+    } else {
+        for (int x = 0; x < width; x++, p += plane.x_stride) {
+            uint16_t h;
+            memcpy(&h, p, sizeof(h));
+            scratch[x] = half_to_float(h);
+        }
+    }
+    return scratch;
+}
+
+std::mutex g_pool_mutex;
+std::unique_ptr<TaskPool> g_pool;
+
+} // namespace
+
+extern "C" {
+
+int sck_api_version(void) { return SCK_API_VERSION; }
+
+void sck_default_params(sck_params* params) {
+    if (!params) return;
+    const KeyerParams p;
+    for (int c = 0; c < 3; c++) params->key_color[c] = p.key_color[c];
+    params->tolerance = p.variance;
+    params->method = p.keying_method;
+    params->gain = p.gain;
+    params->invert = p.invert ? 1 : 0;
+    params->red = p.range_red;
+    params->green = p.range_green;
+    params->blue = p.range_blue;
+    params->yellow = p.range_yellow;
+    params->magenta = p.range_magenta;
+    params->cyan = p.range_cyan;
+}
+
+const char* sck_status_string(int status) {
+    switch (status) {
+        case SCK_OK: return "ok";
+        case SCK_ERROR_ARGUMENT: return "invalid argument";
+        case SCK_ERROR_TYPE: return "unsupported sample type";
+        default: return "unknown status";
+    }
+}
+
+float sck_key_pixel(const sck_params* params, float r, float g, float b) {
+    if (!params) return 0.0f;
+    const KeyerParams p = to_keyer_params(*params);
+    return key_pixel(p, Color3(r, g, b), p.key());
+}
+
+int sck_key_image(const sck_params* params, sck_type type, const sck_plane rgb[3], int width, int height,
+                  float* alpha, ptrdiff_t alpha_x_stride, ptrdiff_t alpha_y_stride, int threads) {
+    if (!params || !rgb || !alpha || width < 0 || height < 0) return SCK_ERROR_ARGUMENT;
+    if (type != SCK_FLOAT32 && type != SCK_FLOAT16) return SCK_ERROR_TYPE;
+    if (params->method < KEY_DISTANCE || params->method > KEY_ADAPTIVE) return SCK_ERROR_ARGUMENT;
+    for (int c = 0; c < 3; c++) {
+        if (!rgb[c].data) return SCK_ERROR_ARGUMENT;
+    }
+    if (width == 0 || height == 0) return SCK_OK;
+
+    const KeyerParams p = to_keyer_params(*params);
+    auto key_rows = [&](int y0, int y1, int) {
+        for (int y = y0; y < y1; y++) {
+            ScratchArena::Scope scope;
+            float* scratch = ScratchArena::local().alloc<float>((size_t)width * 4);
+            const float* r = channel_row(type, rgb[0], y, width, scratch);
+            const float* g = channel_row(type, rgb[1], y, width, scratch + width);
+            const float* b = channel_row(type, rgb[2], y, width, scratch + width * 2);
+            uint8_t* out = reinterpret_cast<uint8_t*>(alpha) + (ptrdiff_t)y * alpha_y_stride;
+            if (alpha_x_stride == sizeof(float)) {
+                key_row(p, r, g, b, reinterpret_cast<float*>(out), width);
+            } else {
+                float* a = scratch + width * 3;
+                key_row(p, r, g, b, a, width);
+                for (int x = 0; x < width; x++, out += alpha_x_stride) memcpy(out, &a[x], sizeof(float));
+            }
+        }
+    };
+
+    if (threads <= 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    // Below ~64K pixels waking the workers costs more than it saves
+    if (threads == 1 || (int64_t)width * height < 65536) {
+        key_rows(0, height, 0);
+        return SCK_OK;
+    }
+    std::lock_guard<std::mutex> lock(g_pool_mutex);
+    if (!g_pool || g_pool->threads() != threads) g_pool.reset(new TaskPool(threads));
+    g_pool->parallel_for(0, height, std::max(1, 8192 / std::max(1, width)), key_rows);
+    return SCK_OK;
+}
+
+} // extern "C"
@@ -0,0 +1,124 @@
+// SimpleColorKeyerCleanPlate.cpp - Build a clean screen plate from a shot
+//
+// Reads raw frames from stdin in one pass and writes the per-pixel
+// temporal median as an rgbf32le plate, e.g.
+//
+//   ffmpeg -i plate.mov -f rawvideo -pix_fmt rgb48le - |
+//     SimpleColorKeyerCleanPlate -s 1920x1080 -i rgb48le --out clean.rgbf32le
+//
+// The plate can be passed to SimpleColorKeyerBatch --plate to key every
+// pixel against its own screen color.
+#include "CleanPlate.h"
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+// Read exactly 'size' bytes; false at end of input
+bool read_frame(uint8_t* buf, size_t size) {
+    size_t got = 0;
+    while (got < size) {
+        ssize_t n = read(STDIN_FILENO, buf + got, size - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            if (got) fprintf(stderr, "Ignoring truncated final frame (%zu of %zu bytes)\n", got, size);
+            return false;
+        }
+        got += (size_t)n;
+    }
+    return true;
+}
+
+void usage() {
+    fprintf(stderr,
+        "Usage: SimpleColorKeyerCleanPlate -s WxH [-i fmt] --out plate.rgbf32le\n"
+        "                                  [--step n] [--threads n] < frames\n"
+        "  -i fmt               Input pixel format (default rgb48le)\n"
+        "  --out f              Output plate (rgbf32le)\n"
+        "  --step n             Use every n-th frame (default 1)\n"
+        "  --threads n          Threads (default: all CPUs)\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int width = 0, height = 0;
+    const FormatName* in_fmt = find_format(in_formats, "rgb48le");
+    std::string out_path;
+    int step = 1;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2) width = 0;
+        } else if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+            in_fmt = find_format(in_formats, argv[++i]);
+        } else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (!strcmp(argv[i], "--step") && i + 1 < argc) {
+            step = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (width <= 0 || height <= 0 || !in_fmt || out_path.empty()) {
+        usage();
+        return 2;
+    }
+
+    const size_t frame_size = input_frame_bytes(*in_fmt, width, height);
+    std::vector<uint8_t> frame(frame_size);
+    CleanPlateBuilder builder(width, height, in_fmt->id);
+
+    auto start = std::chrono::steady_clock::now();
+    int read_frames = 0;
+    while (read_frame(frame.data(), frame_size)) {
+        if (read_frames++ % step) continue;
+        if (builder.full()) {
+            fprintf(stderr, "Reached %d frames, ignoring the rest\n", CleanPlateBuilder::kMaxFrames);
+            break;
+        }
+        builder.add_frame(frame.data(), threads);
+    }
+    if (builder.frames() == 0) {
+        fprintf(stderr, "No frames read\n");
+        return 1;
+    }
+
+    FILE* out = fopen(out_path.c_str(), "wb");
+    if (!out) {
+        perror(out_path.c_str());
+        return 1;
+    }
+    std::vector<float> r(width), g(width), b(width), row((size_t)width * 3);
+    for (int y = 0; y < height; y++) {
+        builder.plate_row(y, r.data(), g.data(), b.data());
+        for (int x = 0; x < width; x++) {
+            row[x * 3] = r[x];
+            row[x * 3 + 1] = g[x];
+            row[x * 3 + 2] = b[x];
+        }
+        if (fwrite(row.data(), sizeof(float), row.size(), out) != row.size()) {
+            perror(out_path.c_str());
+            fclose(out);
+            return 1;
+        }
+    }
+    if (fclose(out) != 0) {
+        perror(out_path.c_str());
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "Clean plate from %d of %d frames in %.2f s (%.1f fps), %.0f MB of estimator state\n",
+            builder.frames(), read_frames, seconds, read_frames / seconds,
+            (double)width * height * 3 * sizeof(P2Median) / (1024.0 * 1024.0));
+    return 0;
+}
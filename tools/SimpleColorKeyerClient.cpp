@@ -0,0 +1,122 @@
+// SimpleColorKeyerClient.cpp - Check a running SimpleColorKeyerServer
+//
+// Keys synthetic frames through the server with ShmKeyerClient, writing
+// each frame straight into the claimed slot (acquire / submit / wait /
+// release), and compares every returned alpha with key_row() run locally.
+// Exits non-zero if the server is unreachable or any alpha differs.
+#include "KeyerToolArgs.h"
+#include "../SimpleColorKeyerShm.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+void usage() {
+    fprintf(stderr,
+        "Usage: SimpleColorKeyerClient [--name /shm_name] [-s WxH] [--frames n] [keyer options]\n"
+        "  --name n             Shared memory name (default %s)\n"
+        "  -s WxH               Frame size (default 1920x1080)\n"
+        "  --frames n           Frames to key (default 30)\n",
+        kShmKeyerDefaultName);
+    print_keyer_usage(stderr);
+}
+
+// Green screen with a noisy foreground block that moves with the frame number
+void fill_frame(int frame, int width, int height, std::mt19937& rng, float* r, float* g, float* b) {
+    std::uniform_real_distribution<float> noise(-0.05f, 0.05f);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int fx = x + frame * 8;
+            bool fg = fx % width > width / 3 && fx % width < 2 * width / 3 && y > height / 4;
+            size_t i = (size_t)y * width + x;
+            r[i] = (fg ? 0.7f : 0.1f) + noise(rng);
+            g[i] = (fg ? 0.5f : 0.8f) + noise(rng);
+            b[i] = (fg ? 0.4f : 0.15f) + noise(rng);
+        }
+    }
+}
+
+double percentile(std::vector<double> v, double q) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    return v[(size_t)(q * (v.size() - 1) + 0.5)];
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    KeyerParams params;
+    const char* name = kShmKeyerDefaultName;
+    int width = 1920, height = 1080, frames = 30;
+
+    for (int i = 1; i < argc; i++) {
+        if (parse_keyer_arg(argc, argv, i, params)) continue;
+        if (!strcmp(argv[i], "--name") && i + 1 < argc) {
+            name = argv[++i];
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2) width = 0;
+        } else if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (width <= 0 || height <= 0 || frames <= 0) {
+        usage();
+        return 2;
+    }
+
+    ShmKeyerClient client;
+    if (!client.connect(name)) {
+        perror(name);
+        return 1;
+    }
+    if (!client.server_alive()) {
+        fprintf(stderr, "%s: server has exited\n", name);
+        return 1;
+    }
+
+    const size_t count = (size_t)width * height;
+    std::vector<float> expected(count);
+    std::vector<double> round_trip_ms;
+    std::mt19937 rng(7);
+    float max_diff = 0.0f;
+
+    for (int f = 0; f < frames; f++) {
+        ShmKeyerClient::Request req;
+        if (!client.acquire(width, height, req)) {
+            perror("acquire");
+            return 1;
+        }
+        fill_frame(f, width, height, rng, req.r, req.g, req.b);
+        key_row(params, req.r, req.g, req.b, expected.data(), (int)count);
+
+        auto start = std::chrono::steady_clock::now();
+        client.submit(req, params);
+        if (!client.wait(req, 10000)) {
+            fprintf(stderr, "Frame %d: no reply from the server\n", f);
+            // Leaves the slot to the server if it is still keying it
+            client.release(req);
+            return 1;
+        }
+        round_trip_ms.push_back(std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count());
+
+        for (size_t i = 0; i < count; i++) {
+            max_diff = std::max(max_diff, std::fabs(req.alpha[i] - expected[i]));
+        }
+        client.release(req);
+    }
+
+    fprintf(stderr, "SimpleColorKeyerClient: %s, %d frames %dx%d\n", name, frames, width, height);
+    fprintf(stderr, "  round trip ms  p50 %.2f  p90 %.2f  max %.2f\n",
+            percentile(round_trip_ms, 0.5), percentile(round_trip_ms, 0.9),
+            percentile(round_trip_ms, 1.0));
+    fprintf(stderr, "  max |alpha - key_row alpha| %.3g\n", max_diff);
+    // Allow for the two binaries being built with different float contraction
+    return max_diff <= 1e-5f ? 0 : 1;
+}
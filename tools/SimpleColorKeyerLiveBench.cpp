@@ -0,0 +1,108 @@
+// SimpleColorKeyerLiveBench.cpp - Latency check for the live keying mode
+//
+// Feeds synthetic frames to LiveKeyer at a fixed frame rate (or as fast as
+// possible) and reports the p50/p99/p999 frame latency against the budget.
+#include "KeyerToolArgs.h"
+#include "../SimpleColorKeyerLive.h"
+#include <random>
+
+namespace {
+
+void usage() {
+    fprintf(stderr,
+        "Usage: SimpleColorKeyerLiveBench [-s WxH] [--fps f] [--frames n] [--threads n]\n"
+        "                                 [--no-pin] [keyer options]\n"
+        "  -s WxH               Frame size (default 1920x1080)\n"
+        "  --fps f              Frame rate to pace at; 0 runs flat out (default 60)\n"
+        "  --frames n           Frames to key (default 1200)\n"
+        "  --threads n          Threads including the caller (default: all CPUs)\n"
+        "  --no-pin             Do not pin workers or the calling thread to CPUs\n");
+    print_keyer_usage(stderr);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    KeyerParams params;
+    int width = 1920, height = 1080, frames = 1200;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    double fps = 60.0;
+    bool pin = true;
+
+    for (int i = 1; i < argc; i++) {
+        if (parse_keyer_arg(argc, argv, i, params)) continue;
+        if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2) width = 0;
+        } else if (!strcmp(argv[i], "--fps") && i + 1 < argc) {
+            fps = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--no-pin")) {
+            pin = false;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (width <= 0 || height <= 0 || frames <= 0) {
+        usage();
+        return 2;
+    }
+
+    // Two alternating plates: green screen with a noisy foreground block
+    const size_t plane = (size_t)width * height;
+    std::vector<float> plates[2];
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> noise(-0.05f, 0.05f);
+    for (int p = 0; p < 2; p++) {
+        plates[p].resize(plane * 3);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                bool fg = (x + p * 16) > width / 3 && (x + p * 16) < 2 * width / 3 && y > height / 4;
+                size_t i = (size_t)y * width + x;
+                plates[p][i] = (fg ? 0.7f : 0.1f) + noise(rng);
+                plates[p][plane + i] = (fg ? 0.5f : 0.8f) + noise(rng);
+                plates[p][2 * plane + i] = (fg ? 0.4f : 0.15f) + noise(rng);
+            }
+        }
+    }
+
+    LiveKeyer keyer(width, height, threads, pin);
+    keyer.set_params(params);
+    // This thread does nothing but key, so it can be pinned with the workers
+    if (pin) keyer.pin_caller();
+
+    // Warm up caches and wake the pool before measuring
+    for (int i = 0; i < 10; i++) {
+        const float* f = plates[i & 1].data();
+        keyer.key(f, f + plane, f + 2 * plane, width);
+    }
+    keyer.histogram().reset();
+
+    const auto period = std::chrono::duration<double>(fps > 0.0 ? 1.0 / fps : 0.0);
+    auto next = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        if (fps > 0.0) {
+            std::this_thread::sleep_until(next);
+            next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+        }
+        const float* f = plates[i & 1].data();
+        keyer.key(f, f + plane, f + 2 * plane, width);
+    }
+
+    const LatencyHistogram& h = keyer.histogram();
+    double budget_us = fps > 0.0 ? 1e6 / fps : 0.0;
+    printf("SimpleColorKeyerLiveBench: %dx%d, %d threads%s, %llu frames\n",
+           width, height, keyer.threads(), pin ? " (pinned)" : "",
+           (unsigned long long)h.count());
+    printf("  latency us  p50 %.0f  p99 %.0f  p999 %.0f  max %.0f\n",
+           h.percentile(0.5), h.percentile(0.99), h.percentile(0.999), h.max());
+    if (budget_us > 0.0) {
+        printf("  budget %.0f us: p999 at %.1f%% of budget, at most %llu frames over\n",
+               budget_us, 100.0 * h.percentile(0.999) / budget_us,
+               (unsigned long long)h.count_above(budget_us));
+    }
+    return 0;
+}
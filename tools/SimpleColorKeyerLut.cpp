@@ -0,0 +1,190 @@
+// SimpleColorKeyerLut.cpp - Export the keyer as a 3D LUT (.cube or CLF)
+//
+// Samples the keyer with the given settings onto an N^3 lattice (KeyLut.h)
+// and writes it as a Resolve/Adobe .cube file or an Academy/ASC Common LUT
+// Format (CLF 3.0) ProcessList. The alpha goes to the chosen output
+// channel: 'all' gives a gray matte, 'r', 'g' or 'b' put it in one channel
+// and pass the input through in the other two. Afterwards the LUT is
+// compared with the exact keyer and the interpolation error is reported:
+//
+//   SimpleColorKeyerLut --out key.cube --size 65 --key 0.1,0.7,0.2 --tolerance 0.25
+//   SimpleColorKeyerLut --out key.clf --channel b --domain 0,2 --method chroma
+//
+// Inputs outside --domain are clamped to it by the LUT. Alpha is a
+// function of RGB only, so every method, expansion, gain and invert setting
+// is represented exactly at the lattice points.
+#include "KeyLut.h"
+#include "KeyerToolArgs.h"
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace {
+
+enum LutFormat { FORMAT_CUBE, FORMAT_CLF };
+enum Channel { CHANNEL_ALL = -1, CHANNEL_R = 0, CHANNEL_G = 1, CHANNEL_B = 2 };
+
+// Output RGB at lattice point (r, g, b)
+void lattice_rgb(const KeyLut& lut, int channel, int r, int g, int b, float out[3]) {
+    const float a = lut.at(r, g, b);
+    if (channel == CHANNEL_ALL) {
+        out[0] = out[1] = out[2] = a;
+        return;
+    }
+    out[0] = lut.value_of(r);
+    out[1] = lut.value_of(g);
+    out[2] = lut.value_of(b);
+    out[channel] = a;
+}
+
+bool write_cube(FILE* f, const KeyLut& lut, int channel, const std::string& title) {
+    fprintf(f, "TITLE \"%s\"\n", title.c_str());
+    fprintf(f, "LUT_3D_SIZE %d\n", lut.size);
+    fprintf(f, "DOMAIN_MIN %g %g %g\n", lut.domain_min, lut.domain_min, lut.domain_min);
+    fprintf(f, "DOMAIN_MAX %g %g %g\n", lut.domain_max, lut.domain_max, lut.domain_max);
+    // Red changes fastest
+    float rgb[3];
+    for (int b = 0; b < lut.size; b++) {
+        for (int g = 0; g < lut.size; g++) {
+            for (int r = 0; r < lut.size; r++) {
+                lattice_rgb(lut, channel, r, g, b, rgb);
+                if (fprintf(f, "%.6f %.6f %.6f\n", rgb[0], rgb[1], rgb[2]) < 0) return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool write_clf(FILE* f, const KeyLut& lut, int channel, const std::string& title) {
+    fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(f, "<ProcessList id=\"SimpleColorKeyer\" compCLFversion=\"3.0\">\n");
+    fprintf(f, "    <Description>%s</Description>\n", title.c_str());
+    if (lut.domain_min != 0.0f || lut.domain_max != 1.0f) {
+        // Map the domain onto the LUT's [0, 1] input range (clamping)
+        fprintf(f, "    <Range inBitDepth=\"32f\" outBitDepth=\"32f\">\n");
+        fprintf(f, "        <minInValue>%g</minInValue>\n        <maxInValue>%g</maxInValue>\n",
+                lut.domain_min, lut.domain_max);
+        fprintf(f, "        <minOutValue>0</minOutValue>\n        <maxOutValue>1</maxOutValue>\n");
+        fprintf(f, "    </Range>\n");
+    }
+    fprintf(f, "    <LUT3D inBitDepth=\"32f\" outBitDepth=\"32f\" interpolation=\"trilinear\">\n");
+    fprintf(f, "        <Array dim=\"%d %d %d 3\">\n", lut.size, lut.size, lut.size);
+    // Blue changes fastest
+    float rgb[3];
+    for (int r = 0; r < lut.size; r++) {
+        for (int g = 0; g < lut.size; g++) {
+            for (int b = 0; b < lut.size; b++) {
+                lattice_rgb(lut, channel, r, g, b, rgb);
+                if (fprintf(f, "%.6f %.6f %.6f\n", rgb[0], rgb[1], rgb[2]) < 0) return false;
+            }
+        }
+    }
+    fprintf(f, "        </Array>\n    </LUT3D>\n</ProcessList>\n");
+    return true;
+}
+
+std::string describe(const KeyerParams& p) {
+    static const char* const methods[] = { "distance", "chroma", "luma", "adaptive" };
+    char s[512];
+    snprintf(s, sizeof(s),
+             "SimpleColorKeyer key %g,%g,%g tolerance %g method %s gain %g%s "
+             "red %g green %g blue %g yellow %g magenta %g cyan %g",
+             p.key_color[0], p.key_color[1], p.key_color[2], p.variance,
+             methods[std::min(std::max(p.keying_method, 0), 3)], p.gain, p.invert ? " invert" : "",
+             p.range_red, p.range_green, p.range_blue, p.range_yellow, p.range_magenta, p.range_cyan);
+    return s;
+}
+
+bool ends_with(const std::string& s, const char* suffix) {
+    size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+void usage() {
+    fprintf(stderr,
+        "Usage: SimpleColorKeyerLut --out file.cube|file.clf [--size n] [--channel c]\n"
+        "                           [--domain min,max] [--format f] [--check n]\n"
+        "                           [--threads n] [keyer options]\n"
+        "  --out f              Output LUT; the format follows the extension\n"
+        "  --format f           cube | clf, overriding the extension\n"
+        "  --size n             Lattice points per axis, 2 to 256 (default 33)\n"
+        "  --channel c          all | r | g | b: where the alpha goes (default all);\n"
+        "                       with r, g or b the other two pass the input through\n"
+        "  --domain min,max     Input range covered by the lattice (default 0,1)\n"
+        "  --check n            Random inputs compared with the exact keyer (default 1000000)\n"
+        "  --threads n          Threads (default: all CPUs)\n");
+    print_keyer_usage(stderr);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    KeyerParams params;
+    std::string out_path;
+    int format = -1;
+    int size = 33;
+    int channel = CHANNEL_ALL;
+    float domain_min = 0.0f, domain_max = 1.0f;
+    long long check = 1000000;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; i++) {
+        if (parse_keyer_arg(argc, argv, i, params)) {
+            continue;
+        } else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (!strcmp(argv[i], "--format") && i + 1 < argc) {
+            const char* f = argv[++i];
+            format = !strcmp(f, "cube") ? FORMAT_CUBE : !strcmp(f, "clf") ? FORMAT_CLF : -2;
+        } else if (!strcmp(argv[i], "--size") && i + 1 < argc) {
+            size = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--channel") && i + 1 < argc) {
+            const char* c = argv[++i];
+            channel = !strcmp(c, "all") ? CHANNEL_ALL : !strcmp(c, "r") ? CHANNEL_R
+                    : !strcmp(c, "g") ? CHANNEL_G : !strcmp(c, "b") ? CHANNEL_B : -2;
+        } else if (!strcmp(argv[i], "--domain") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%f,%f", &domain_min, &domain_max) != 2) domain_max = domain_min;
+        } else if (!strcmp(argv[i], "--check") && i + 1 < argc) {
+            check = std::max(0LL, atoll(argv[++i]));
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (format == -1) {
+        format = ends_with(out_path, ".clf") || ends_with(out_path, ".xml") ? FORMAT_CLF : FORMAT_CUBE;
+    }
+    if (out_path.empty() || format < 0 || channel == -2 || size < 2 || size > 256 ||
+        !(domain_max > domain_min)) {
+        usage();
+        return 2;
+    }
+
+    TaskPool pool(threads);
+    auto start = std::chrono::steady_clock::now();
+    KeyLut lut = build_key_lut(params, size, domain_min, domain_max, pool);
+    double build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    FILE* f = fopen(out_path.c_str(), "w");
+    if (!f) {
+        perror(out_path.c_str());
+        return 1;
+    }
+    const std::string title = describe(params);
+    bool ok = format == FORMAT_CLF ? write_clf(f, lut, channel, title) : write_cube(f, lut, channel, title);
+    if (fclose(f) != 0 || !ok) {
+        perror(out_path.c_str());
+        return 1;
+    }
+    fprintf(stderr, "%s: %d^3 %s LUT built in %.1f ms on %d threads\n", out_path.c_str(), size,
+            format == FORMAT_CLF ? "CLF" : "cube", build_ms, pool.threads());
+
+    LutError err = measure_lut_error(lut, params, (uint64_t)check, pool);
+    fprintf(stderr, "Interpolation error over %llu inputs: max %.5f at (%.4f, %.4f, %.4f), mean %.6f, "
+                    "%.3f%% above 1/255\n",
+            (unsigned long long)err.samples, err.max, err.worst.r, err.worst.g, err.worst.b, err.mean,
+            100.0 * err.above_8bit);
+    return 0;
+}
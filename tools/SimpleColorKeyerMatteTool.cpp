@@ -0,0 +1,82 @@
+// SimpleColorKeyerMatteTool.cpp - Inspect and decode .sckm matte files
+//
+//   SimpleColorKeyerMatteTool info matte.1001.sckm
+//   SimpleColorKeyerMatteTool decode matte.1001.sckm > matte.grayf32le
+//   SimpleColorKeyerMatteTool rows matte.1001.sckm 500-540 > band.grayf32le
+#include "../SimpleColorKeyerMatte.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdlib>
+
+namespace {
+
+void usage() {
+    fprintf(stderr,
+        "Usage: SimpleColorKeyerMatteTool info FILE\n"
+        "       SimpleColorKeyerMatteTool decode FILE           (grayf32le to stdout)\n"
+        "       SimpleColorKeyerMatteTool rows FILE first-last  (grayf32le to stdout)\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        usage();
+        return 2;
+    }
+    const char* cmd = argv[1];
+
+    int fd = open(argv[2], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(argv[2]);
+        return 1;
+    }
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    MatteReader reader;
+    if (!reader.open(static_cast<const uint8_t*>(map), st.st_size)) {
+        fprintf(stderr, "%s: not a valid .sckm file\n", argv[2]);
+        return 1;
+    }
+
+    int first = 0, last = reader.height() - 1;
+    if (!strcmp(cmd, "info")) {
+        double raw = (double)reader.width() * reader.height() * sizeof(float);
+        printf("%s: %dx%d, %s, %lld bytes (%.1f%% of float, %.2f bits/pixel)\n", argv[2],
+               reader.width(), reader.height(),
+               reader.encoding() == MATTE_HALF ? "half" : "unorm16",
+               (long long)st.st_size, 100.0 * st.st_size / raw,
+               8.0 * st.st_size / ((double)reader.width() * reader.height()));
+        return 0;
+    } else if (!strcmp(cmd, "rows")) {
+        if (argc < 4 || sscanf(argv[3], "%d-%d", &first, &last) != 2 ||
+            first < 0 || last >= reader.height() || last < first) {
+            usage();
+            return 2;
+        }
+    } else if (strcmp(cmd, "decode")) {
+        usage();
+        return 2;
+    }
+
+    std::vector<float> row(reader.width());
+    for (int y = first; y <= last; y++) {
+        if (!reader.read_row(y, row.data())) {
+            fprintf(stderr, "%s: corrupt row %d\n", argv[2], y);
+            return 1;
+        }
+        if (fwrite(row.data(), sizeof(float), row.size(), stdout) != row.size()) {
+            perror("write");
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,741 @@
+// SimpleColorKeyerMicroBench.cpp - Per-function keying microbenchmarks
+//
+// Times each calculate_*_alpha path and the engine() row loop on their own,
+// over row lengths, with the color-range expansion knobs off or on, and on
+// three input distributions:
+//
+//   screen      every pixel near the key color (alpha mostly 1)
+//   foreground  every pixel far from the key (alpha 0)
+//   edges       ramps between screen and foreground (alpha in between)
+//
+// Results are written as JSON so ns/pixel can be tracked across releases.
+// With --counters, hardware counters (PerfCounters.h) are read over the
+// timed repetitions and reported per pixel next to the throughput.
+//
+// --roofline instead measures the host's STREAM copy and triad bandwidth
+// (StreamBandwidth.h), then keys whole frames larger than the last-level
+// cache with every method on all threads, and reports bytes/pixel, the
+// fraction of peak bandwidth reached and each kernel's arithmetic intensity.
+//
+// --scaling keys whole frames with each calculate_*_alpha kernel at
+// increasing thread counts, once with threads spawned per frame over a
+// static split of the rows and once with the work-stealing TaskPool
+// (SimpleColorKeyerTasks.h). The frame is half screen, a quarter edges and
+// a quarter foreground, so rows do not all cost the same.
+//
+// --id-matte times the nearest-color search of ID matte extraction
+// (SimpleColorKeyerIdMatte.h) for palettes of 4 to 256 colors on a
+// synthetic ID pass: brute force, the RGB grid, the automatic choice and,
+// up to 64 colors, keying each color separately as one node per matte would:
+//
+//   SimpleColorKeyerMicroBench --json bench.json
+//   SimpleColorKeyerMicroBench --filter chroma --lengths 1024,16384 --counters
+//   SimpleColorKeyerMicroBench --roofline --frame 3840x2160 --threads 32
+//   SimpleColorKeyerMicroBench --scaling --thread-counts 1,2,4,8,16,32,64,128
+//   SimpleColorKeyerMicroBench --id-matte --palette-sizes 4,16,64,256
+#include "../SimpleColorKeyerArena.h"
+#include "../SimpleColorKeyerCore.h"
+#include "../SimpleColorKeyerIdMatte.h"
+#include "../SimpleColorKeyerTasks.h"
+#include "PerfCounters.h"
+#include "StreamBandwidth.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum Distribution { DIST_SCREEN, DIST_FOREGROUND, DIST_EDGES };
+static const char* const kDistributionNames[] = { "screen", "foreground", "edges" };
+
+// Keep the compiler from discarding or hoisting work on 'p'
+inline void clobber(const void* p) {
+#if defined(__GNUC__)
+    asm volatile("" : : "r"(p) : "memory");
+#else
+    static volatile const void* sink;
+    sink = p;
+#endif
+}
+
+struct Input {
+    std::vector<float> r, g, b;
+};
+
+Input make_input(Distribution dist, int length, const KeyerParams& p, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, 0.02f);
+    Input in;
+    in.r.resize(length);
+    in.g.resize(length);
+    in.b.resize(length);
+    for (int i = 0; i < length; i++) {
+        Color3 screen(p.key_color[0] + noise(rng), p.key_color[1] + noise(rng), p.key_color[2] + noise(rng));
+        // Skin, cloth and highlights: well away from a green or blue key
+        Color3 fg(0.3f + 0.6f * unit(rng), 0.1f + 0.3f * unit(rng), 0.1f + 0.5f * unit(rng));
+        Color3 c = screen;
+        if (dist == DIST_FOREGROUND) {
+            c = fg;
+        } else if (dist == DIST_EDGES) {
+            // 16-pixel ramps from screen to foreground
+            float t = (i % 16) / 15.0f;
+            c = Color3(screen.r + (fg.r - screen.r) * t, screen.g + (fg.g - screen.g) * t,
+                       screen.b + (fg.b - screen.b) * t);
+        }
+        in.r[i] = c.r;
+        in.g[i] = c.g;
+        in.b[i] = c.b;
+    }
+    return in;
+}
+
+// Every direction active, with both signs, so no branch is skipped
+void set_expansion(KeyerParams& p) {
+    p.range_red = 0.3f;
+    p.range_magenta = -0.2f;
+    p.range_green = 0.5f;
+    p.range_yellow = -0.1f;
+    p.range_blue = 0.2f;
+    p.range_cyan = -0.4f;
+}
+
+// Planar float rows a benchmarked function reads and writes
+struct RowBuffers {
+    const float* r;
+    const float* g;
+    const float* b;
+    float* out_r;               // output row RGB (engine_row only)
+    float* out_g;
+    float* out_b;
+    float* alpha;
+};
+
+// One benchmarked function: key 'count' pixels
+typedef void (*RowFunction)(const KeyerParams& p, const RowBuffers& row, int count);
+
+template <float (*F)(const KeyerParams&, const Color3&, const Color3&)>
+void alpha_row(const KeyerParams& p, const RowBuffers& row, int count) {
+    const Color3 key = p.key();
+    for (int i = 0; i < count; i++) row.alpha[i] = F(p, Color3(row.r[i], row.g[i], row.b[i]), key);
+}
+
+// Mirrors SimpleColorKeyerIop::engine() with no optional feature on: open a
+// scratch scope, let the input fill the output row's RGB (input0().get()
+// into the output row, a copy here), then key that row with key_row()
+void engine_row(const KeyerParams& p, const RowBuffers& row, int count) {
+    ScratchArena::Scope scratch;
+    memcpy(row.out_r, row.r, count * sizeof(float));
+    memcpy(row.out_g, row.g, count * sizeof(float));
+    memcpy(row.out_b, row.b, count * sizeof(float));
+    key_row(p, row.out_r, row.out_g, row.out_b, row.alpha, count);
+}
+
+struct Function {
+    const char* name;
+    RowFunction run;
+    // Bytes of planar float read and written per pixel
+    int bytes_per_pixel;
+    // Arithmetic operations per pixel (add, mul, div, sqrt, min/max), counted
+    // from SimpleColorKeyerCore.h with the expansion knobs off and on
+    int flops, flops_expansion;
+};
+
+const Function kFunctions[] = {
+    { "distance", alpha_row<calculate_distance_alpha>, 16, 13, 34 },
+    { "chroma", alpha_row<calculate_chroma_alpha>, 16, 11, 11 },
+    { "luma_weighted", alpha_row<calculate_luma_weighted_alpha>, 16, 24, 45 },
+    { "adaptive", alpha_row<calculate_adaptive_alpha>, 16, 27, 48 },
+    { "engine_row", engine_row, 28, 16, 37 },
+};
+
+struct Result {
+    const char* function;
+    int length;
+    bool expansion;
+    Distribution dist;
+    double ns_per_pixel;        // median over repetitions
+    double ns_per_pixel_min;
+    long iterations;            // rows per repetition
+    std::vector<double> samples;    // ns/pixel of each repetition
+    PerfSample counters;        // summed over all repetitions (--counters)
+    double pixels = 0.0;        // pixels keyed while counting
+};
+
+// Median and minimum ns/pixel over 'reps' repetitions of at least
+// 'min_seconds' each
+Result run_case(const Function& f, const KeyerParams& p, const Input& in, int length,
+                int reps, double min_seconds, PerfCounters* counters) {
+    std::vector<float> out(length * 4);
+    const RowBuffers row = { in.r.data(), in.g.data(), in.b.data(), &out[length], &out[length * 2],
+                             &out[length * 3], out.data() };
+
+    // Calibrate the iteration count so one repetition lasts min_seconds
+    long iterations = 1;
+    for (;;) {
+        auto t0 = std::chrono::steady_clock::now();
+        for (long i = 0; i < iterations; i++) {
+            f.run(p, row, length);
+            clobber(out.data());
+        }
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (s >= min_seconds) break;
+        iterations = s > 0.0 ? std::max(iterations * 2, (long)(iterations * min_seconds / s * 1.2))
+                             : iterations * 10;
+    }
+
+    std::vector<double> samples;
+    if (counters) counters->start();
+    for (int rep = 0; rep < reps; rep++) {
+        auto t0 = std::chrono::steady_clock::now();
+        for (long i = 0; i < iterations; i++) {
+            f.run(p, row, length);
+            clobber(out.data());
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+        samples.push_back(ns / ((double)iterations * length));
+    }
+    Result r;
+    if (counters) r.counters = counters->stop();
+    r.pixels = (double)iterations * length * reps;
+    std::sort(samples.begin(), samples.end());
+
+    r.function = f.name;
+    r.length = length;
+    r.expansion = false;
+    r.dist = DIST_SCREEN;
+    r.samples = samples;
+    r.ns_per_pixel = samples[samples.size() / 2];
+    r.ns_per_pixel_min = samples.front();
+    r.iterations = iterations;
+    return r;
+}
+
+// Counter 'e' per pixel, or -1 when it was not counted
+double per_pixel(const Result& r, PerfEvent e) {
+    return r.counters.valid[e] && r.pixels > 0.0 ? r.counters.value[e] / r.pixels : -1.0;
+}
+
+double ipc(const Result& r) {
+    const PerfSample& c = r.counters;
+    if (!c.valid[PERF_CYCLES] || !c.valid[PERF_INSTRUCTIONS] || c.value[PERF_CYCLES] <= 0.0) return -1.0;
+    return c.value[PERF_INSTRUCTIONS] / c.value[PERF_CYCLES];
+}
+
+struct RooflineKernel {
+    const char* function;
+    bool expansion;
+    double ns_per_pixel;        // wall time per pixel, all threads together
+    double bytes_per_pixel;
+    double gbs;                 // achieved DRAM traffic, 1e9 bytes/s
+    double percent_of_peak;     // of the triad bandwidth
+    double flops_per_pixel;
+    double intensity;           // flops per byte
+    double gflops;
+};
+
+struct Roofline {
+    int width = 3840, height = 2160;
+    int threads = 1;
+    size_t llc_bytes = 0;
+    StreamResult stream;
+    std::vector<RooflineKernel> kernels;
+};
+
+// Key whole frames with every selected function and place each on the
+// roofline defined by the measured triad bandwidth
+void run_roofline(Roofline& roof, const std::string& filter, int reps) {
+    const size_t pixels = (size_t)roof.width * roof.height;
+    roof.llc_bytes = last_level_cache_bytes();
+    // Well beyond the LLC so the arrays stream from DRAM
+    const size_t stream_bytes = std::max<size_t>(roof.llc_bytes * 4, 256u << 20);
+    roof.stream = measure_stream(stream_bytes, roof.threads, std::max(reps, 3));
+    fprintf(stderr, "STREAM (%d threads, %.0f MB arrays): copy %.1f GB/s, triad %.1f GB/s\n",
+            roof.threads, roof.stream.array_bytes / 1048576.0, roof.stream.copy_gbs, roof.stream.triad_gbs);
+    if (roof.llc_bytes && pixels * 16 < roof.llc_bytes * 4) {
+        fprintf(stderr, "Warning: a %dx%d frame is not much larger than the %.0f MB LLC\n",
+                roof.width, roof.height, roof.llc_bytes / 1048576.0);
+    }
+
+    // Planar frame, first-touched by the rows each thread will key
+    std::unique_ptr<float[]> planes(new float[pixels * 7]);
+    float* base = planes.get();
+    const RowBuffers frame = { base, base + pixels, base + pixels * 2, base + pixels * 3,
+                               base + pixels * 4, base + pixels * 5, base + pixels * 6 };
+    KeyerParams defaults;
+    run_partitioned(roof.threads, (size_t)roof.height, [&](size_t y0, size_t y1) {
+        for (size_t y = y0; y < y1; y++) {
+            Input in = make_input(DIST_EDGES, roof.width, defaults, 77u + (uint32_t)y);
+            const size_t at = y * roof.width;
+            std::copy(in.r.begin(), in.r.end(), base + at);
+            std::copy(in.g.begin(), in.g.end(), base + pixels + at);
+            std::copy(in.b.begin(), in.b.end(), base + pixels * 2 + at);
+            for (int plane = 3; plane < 7; plane++) {
+                std::fill(base + pixels * plane + at, base + pixels * plane + at + roof.width, 0.0f);
+            }
+        }
+    });
+
+    for (const Function& f : kFunctions) {
+        if (!filter.empty() && !strstr(f.name, filter.c_str())) continue;
+        for (int expansion = 0; expansion < 2; expansion++) {
+            KeyerParams p;
+            if (expansion) set_expansion(p);
+            double best = 1e30;
+            for (int rep = 0; rep < reps; rep++) {
+                auto t0 = std::chrono::steady_clock::now();
+                run_partitioned(roof.threads, (size_t)roof.height, [&](size_t y0, size_t y1) {
+                    for (size_t y = y0; y < y1; y++) {
+                        const size_t at = y * roof.width;
+                        const RowBuffers row = { frame.r + at, frame.g + at, frame.b + at, frame.out_r + at,
+                                                 frame.out_g + at, frame.out_b + at, frame.alpha + at };
+                        f.run(p, row, roof.width);
+                    }
+                });
+                clobber(frame.alpha);
+                best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+            }
+
+            RooflineKernel k;
+            k.function = f.name;
+            k.expansion = expansion != 0;
+            k.ns_per_pixel = best * 1e9 / pixels;
+            k.bytes_per_pixel = f.bytes_per_pixel;
+            k.gbs = k.bytes_per_pixel * pixels / best * 1e-9;
+            k.percent_of_peak = 100.0 * k.gbs / roof.stream.triad_gbs;
+            k.flops_per_pixel = expansion ? f.flops_expansion : f.flops;
+            k.intensity = k.flops_per_pixel / k.bytes_per_pixel;
+            k.gflops = k.flops_per_pixel * pixels / best * 1e-9;
+            roof.kernels.push_back(k);
+            fprintf(stderr, "%-14s %-3s %7.3f ns/pixel  %4.0f B/pixel  %6.1f GB/s (%5.1f%% of triad)  "
+                            "%5.2f flop/B  %6.1f GFLOP/s  %s\n",
+                    k.function, expansion ? "exp" : "-", k.ns_per_pixel, k.bytes_per_pixel, k.gbs,
+                    k.percent_of_peak, k.intensity, k.gflops,
+                    k.percent_of_peak >= 70.0 ? "bandwidth-bound" : "compute-bound");
+        }
+    }
+}
+
+struct ScalingPoint {
+    const char* function;
+    int threads;
+    const char* scheduler;      // "spawn" (static split) or "pool" (TaskPool)
+    double ms_per_frame;        // best of the repetitions
+    double speedup;             // over the pool at the first thread count
+    double efficiency;          // speedup / threads
+};
+
+struct Scaling {
+    int width = 3840, height = 2160;
+    std::vector<int> thread_counts = { 1, 2, 4, 8, 16, 32, 64 };
+    int grain = 4;              // rows per TaskPool chunk
+    std::vector<ScalingPoint> points;
+};
+
+// Key a frame with every calculate_*_alpha kernel at each thread count,
+// spawning threads per frame over a static split and with a TaskPool
+void run_scaling(Scaling& sc, const std::string& filter, int reps) {
+    const int width = sc.width, height = sc.height;
+    const size_t pixels = (size_t)width * height;
+    std::unique_ptr<float[]> planes(new float[pixels * 4]);
+    float* base = planes.get();
+    KeyerParams defaults;
+    for (int y = 0; y < height; y++) {
+        // Screen on top, then edges, then foreground
+        const Distribution d = y < height / 2 ? DIST_SCREEN : y < height * 3 / 4 ? DIST_EDGES : DIST_FOREGROUND;
+        Input in = make_input(d, width, defaults, 99u + (uint32_t)y);
+        const size_t at = (size_t)y * width;
+        std::copy(in.r.begin(), in.r.end(), base + at);
+        std::copy(in.g.begin(), in.g.end(), base + pixels + at);
+        std::copy(in.b.begin(), in.b.end(), base + pixels * 2 + at);
+    }
+    float* alpha = base + pixels * 3;
+    std::fill(alpha, alpha + pixels, 0.0f);
+
+    for (const Function& f : kFunctions) {
+        if (f.run == engine_row) continue;
+        if (!filter.empty() && !strstr(f.name, filter.c_str())) continue;
+        KeyerParams p;
+        set_expansion(p);
+        auto key_rows = [&](int y0, int y1) {
+            for (int y = y0; y < y1; y++) {
+                const size_t at = (size_t)y * width;
+                const RowBuffers row = { base + at, base + pixels + at, base + pixels * 2 + at,
+                                         nullptr, nullptr, nullptr, alpha + at };
+                f.run(p, row, width);
+            }
+        };
+
+        double single = 0.0;
+        for (int threads : sc.thread_counts) {
+            TaskPool pool(threads);
+            ScalingPoint pts[2];
+            for (int scheduler = 0; scheduler < 2; scheduler++) {
+                double best = 1e30;
+                for (int rep = 0; rep < reps; rep++) {
+                    auto t0 = std::chrono::steady_clock::now();
+                    if (scheduler == 0) {
+                        pool.parallel_for(0, height, sc.grain, [&](int y0, int y1, int) { key_rows(y0, y1); });
+                    } else {
+                        run_partitioned(threads, (size_t)height, [&](size_t y0, size_t y1) {
+                            key_rows((int)y0, (int)y1);
+                        });
+                    }
+                    clobber(alpha);
+                    best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+                }
+
+                ScalingPoint& pt = pts[scheduler];
+                pt.function = f.name;
+                pt.threads = threads;
+                pt.scheduler = scheduler == 0 ? "pool" : "spawn";
+                pt.ms_per_frame = best * 1e3;
+                if (single == 0.0) single = pt.ms_per_frame;
+                pt.speedup = single / pt.ms_per_frame;
+                pt.efficiency = pt.speedup / threads;
+                sc.points.push_back(pt);
+            }
+            fprintf(stderr, "%-14s %4d threads  pool %8.2f ms (%6.2fx, %3.0f%%)  spawn %8.2f ms (%6.2fx, %3.0f%%)\n",
+                    f.name, threads, pts[0].ms_per_frame, pts[0].speedup, 100.0 * pts[0].efficiency,
+                    pts[1].ms_per_frame, pts[1].speedup, 100.0 * pts[1].efficiency);
+        }
+    }
+}
+
+struct IdMatteCase {
+    int colors;
+    double brute_ns;            // per pixel, one thread
+    double grid_ns;
+    double auto_ns;
+    const char* auto_search;
+    double separate_ns;         // one distance key per color; 0 when not run
+};
+
+struct IdMatteBench {
+    int width = 1024, height = 1024;
+    float tolerance = 0.05f;
+    std::vector<int> palette_sizes = { 4, 8, 16, 32, 64, 128, 256 };
+    std::vector<IdMatteCase> cases;
+};
+
+// Time the ID matte search over a synthetic ID pass for each palette size
+void run_id_matte(IdMatteBench& bench, int reps) {
+    const int width = bench.width, height = bench.height;
+    const size_t pixels = (size_t)width * height;
+    std::vector<float> r(pixels), g(pixels), b(pixels), coverage(pixels);
+    std::vector<int> index(pixels);
+
+    for (int n : bench.palette_sizes) {
+        std::mt19937 rng(4242u + n);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<Color3> colors;
+        for (int k = 0; k < n; k++) colors.push_back(Color3(unit(rng), unit(rng), unit(rng)));
+        IdPalette palette;
+        palette.set(colors, bench.tolerance);
+
+        // Flat 8-pixel runs of one color; one pixel in eight an antialiased
+        // blend of two
+        for (size_t i = 0; i < pixels; i += 8) {
+            const Color3& c = colors[rng() % n];
+            for (size_t j = i; j < std::min(pixels, i + 8); j++) {
+                r[j] = c.r;
+                g[j] = c.g;
+                b[j] = c.b;
+            }
+            const Color3& d = colors[rng() % n];
+            const float t = unit(rng);
+            r[i] = c.r + (d.r - c.r) * t;
+            g[i] = c.g + (d.g - c.g) * t;
+            b[i] = c.b + (d.b - c.b) * t;
+        }
+
+        auto time_frame = [&](int repetitions, const std::function<void(int y)>& row) {
+            double best = 1e30;
+            for (int rep = 0; rep < repetitions; rep++) {
+                auto t0 = std::chrono::steady_clock::now();
+                for (int y = 0; y < height; y++) row(y);
+                clobber(index.data());
+                clobber(coverage.data());
+                best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+            }
+            return best * 1e9 / pixels;
+        };
+        auto search = [&](IdPalette::Search s) {
+            return time_frame(reps, [&](int y) {
+                const size_t at = (size_t)y * width;
+                palette.match_row(&r[at], &g[at], &b[at], width, &index[at], &coverage[at], s);
+            });
+        };
+
+        IdMatteCase c;
+        c.colors = n;
+        c.brute_ns = search(IdPalette::SEARCH_BRUTE);
+        c.grid_ns = search(IdPalette::SEARCH_GRID);
+        c.auto_ns = search(IdPalette::SEARCH_AUTO);
+        c.auto_search = n <= IdPalette::kBruteForceMax ? "brute" : "grid";
+        c.separate_ns = 0.0;
+        if (n <= 64) {
+            KeyerParams p;
+            p.variance = bench.tolerance;
+            c.separate_ns = time_frame(std::min(reps, 3), [&](int y) {
+                const size_t at = (size_t)y * width;
+                for (int k = 0; k < n; k++) {
+                    p.key_color[0] = colors[k].r;
+                    p.key_color[1] = colors[k].g;
+                    p.key_color[2] = colors[k].b;
+                    key_row(p, &r[at], &g[at], &b[at], &coverage[at], width);
+                }
+            });
+        }
+        bench.cases.push_back(c);
+        fprintf(stderr, "id-matte %4d colors  brute %8.3f  grid %8.3f  auto (%s) %8.3f ns/pixel", n,
+                c.brute_ns, c.grid_ns, c.auto_search, c.auto_ns);
+        if (c.separate_ns > 0.0) {
+            fprintf(stderr, "  separate keys %9.3f ns/pixel (%.1fx)", c.separate_ns, c.separate_ns / c.auto_ns);
+        }
+        fprintf(stderr, "\n");
+    }
+}
+
+void write_json(FILE* out, const std::vector<Result>& results, int reps, double min_seconds,
+                const Roofline* roof, const Scaling* scaling, const IdMatteBench* id_matte) {
+    fprintf(out, "{\n  \"benchmark\": \"SimpleColorKeyerMicroBench\",\n  \"version\": 2,\n");
+#if defined(__VERSION__)
+    fprintf(out, "  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+    fprintf(out, "  \"repetitions\": %d,\n  \"min_seconds\": %g,\n  \"results\": [\n", reps, min_seconds);
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        fprintf(out,
+                "    {\"function\": \"%s\", \"row_length\": %d, \"expansion\": %s, \"distribution\": \"%s\", "
+                "\"ns_per_pixel\": %.4f, \"ns_per_pixel_min\": %.4f, \"iterations\": %ld",
+                r.function, r.length, r.expansion ? "true" : "false", kDistributionNames[r.dist],
+                r.ns_per_pixel, r.ns_per_pixel_min, r.iterations);
+        fprintf(out, ", \"samples\": [");
+        for (size_t j = 0; j < r.samples.size(); j++) fprintf(out, "%s%.4f", j ? ", " : "", r.samples[j]);
+        fprintf(out, "]");
+        if (r.counters.valid[PERF_CYCLES]) {
+            // Per-pixel counts; events the PMU did not provide are omitted
+            fprintf(out, ", \"counters\": {");
+            const char* sep = "";
+            if (ipc(r) >= 0.0) {
+                fprintf(out, "\"ipc\": %.3f", ipc(r));
+                sep = ", ";
+            }
+            for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+                if (!r.counters.valid[e]) continue;
+                fprintf(out, "%s\"%s_per_pixel\": %.5f", sep, kPerfEventNames[e], per_pixel(r, (PerfEvent)e));
+                sep = ", ";
+            }
+            fprintf(out, "}");
+        }
+        fprintf(out, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]");
+    if (roof) {
+        fprintf(out, ",\n  \"roofline\": {\"frame\": \"%dx%d\", \"threads\": %d, \"llc_bytes\": %zu, "
+                     "\"stream_array_bytes\": %zu, \"copy_gbs\": %.2f, \"triad_gbs\": %.2f, \"kernels\": [\n",
+                roof->width, roof->height, roof->threads, roof->llc_bytes, roof->stream.array_bytes,
+                roof->stream.copy_gbs, roof->stream.triad_gbs);
+        for (size_t i = 0; i < roof->kernels.size(); i++) {
+            const RooflineKernel& k = roof->kernels[i];
+            fprintf(out,
+                    "    {\"function\": \"%s\", \"expansion\": %s, \"ns_per_pixel\": %.4f, "
+                    "\"bytes_per_pixel\": %.0f, \"gbs\": %.2f, \"percent_of_peak\": %.1f, "
+                    "\"flops_per_pixel\": %.0f, \"arithmetic_intensity\": %.3f, \"gflops\": %.2f}%s\n",
+                    k.function, k.expansion ? "true" : "false", k.ns_per_pixel, k.bytes_per_pixel, k.gbs,
+                    k.percent_of_peak, k.flops_per_pixel, k.intensity, k.gflops,
+                    i + 1 < roof->kernels.size() ? "," : "");
+        }
+        fprintf(out, "  ]}");
+    }
+    if (scaling) {
+        fprintf(out, ",\n  \"scaling\": {\"frame\": \"%dx%d\", \"grain_rows\": %d, \"points\": [\n",
+                scaling->width, scaling->height, scaling->grain);
+        for (size_t i = 0; i < scaling->points.size(); i++) {
+            const ScalingPoint& pt = scaling->points[i];
+            fprintf(out,
+                    "    {\"function\": \"%s\", \"threads\": %d, \"scheduler\": \"%s\", \"ms_per_frame\": %.3f, "
+                    "\"speedup\": %.3f, \"efficiency\": %.3f}%s\n",
+                    pt.function, pt.threads, pt.scheduler, pt.ms_per_frame, pt.speedup, pt.efficiency,
+                    i + 1 < scaling->points.size() ? "," : "");
+        }
+        fprintf(out, "  ]}");
+    }
+    if (id_matte) {
+        fprintf(out, ",\n  \"id_matte\": {\"frame\": \"%dx%d\", \"tolerance\": %g, \"threads\": 1, \"cases\": [\n",
+                id_matte->width, id_matte->height, id_matte->tolerance);
+        for (size_t i = 0; i < id_matte->cases.size(); i++) {
+            const IdMatteCase& c = id_matte->cases[i];
+            fprintf(out,
+                    "    {\"colors\": %d, \"brute_ns_per_pixel\": %.4f, \"grid_ns_per_pixel\": %.4f, "
+                    "\"auto_ns_per_pixel\": %.4f, \"auto_search\": \"%s\"",
+                    c.colors, c.brute_ns, c.grid_ns, c.auto_ns, c.auto_search);
+            if (c.separate_ns > 0.0) fprintf(out, ", \"separate_keys_ns_per_pixel\": %.4f", c.separate_ns);
+            fprintf(out, "}%s\n", i + 1 < id_matte->cases.size() ? "," : "");
+        }
+        fprintf(out, "  ]}");
+    }
+    fprintf(out, "\n}\n");
+}
+
+void usage() {
+    fprintf(stderr,
+        "Usage: SimpleColorKeyerMicroBench [--json file] [--filter name] [--lengths a,b,...]\n"
+        "                                  [--reps n] [--min-time ms] [--counters]\n"
+        "       SimpleColorKeyerMicroBench --roofline [--frame WxH] [--threads n]\n"
+        "  --json f             Write results as JSON to f (default: stdout)\n"
+        "  --filter s           Only functions whose name contains s\n"
+        "  --lengths list       Row lengths (default 64,256,1024,4096,16384)\n"
+        "  --reps n             Timed repetitions per case, median reported (default 7)\n"
+        "  --min-time ms        Minimum duration of one repetition (default 20)\n"
+        "  --counters           Also read hardware counters (cycles, instructions, branch,\n"
+        "                       L1D and LLC misses, stalls) if the kernel allows it\n"
+        "  --roofline           Measure STREAM bandwidth, then key whole frames and report\n"
+        "                       bandwidth use and arithmetic intensity per method\n"
+        "       SimpleColorKeyerMicroBench --scaling [--frame WxH] [--thread-counts a,b,...]\n"
+        "  --frame WxH          Frame size for --roofline and --scaling (default 3840x2160)\n"
+        "  --threads n          Threads for --roofline (default: all CPUs)\n"
+        "  --scaling            Key whole frames at each thread count, with threads spawned\n"
+        "                       per frame and with the work-stealing TaskPool\n"
+        "  --thread-counts list Thread counts for --scaling (default 1,2,4,...,64 and the\n"
+        "                       number of CPUs)\n"
+        "       SimpleColorKeyerMicroBench --id-matte [--palette-sizes a,b,...]\n"
+        "  --id-matte           Time the ID matte nearest-color search on a 1024x1024 ID\n"
+        "                       pass, one thread, against keying each color separately\n"
+        "  --palette-sizes list Palette sizes for --id-matte (default 4,8,16,...,256)\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string json_path, filter;
+    std::vector<int> lengths = { 64, 256, 1024, 4096, 16384 };
+    int reps = 7;
+    double min_seconds = 0.02;
+    bool use_counters = false;
+    bool roofline = false, scaling = false, id_matte = false;
+    Roofline roof;
+    Scaling sc;
+    IdMatteBench id_bench;
+    roof.threads = (int)std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--json") && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (!strcmp(argv[i], "--lengths") && i + 1 < argc) {
+            lengths.clear();
+            for (char* s = argv[++i]; *s;) {
+                int n = (int)strtol(s, &s, 10);
+                if (n > 0) lengths.push_back(n);
+                if (*s) s++;
+            }
+        } else if (!strcmp(argv[i], "--reps") && i + 1 < argc) {
+            reps = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--min-time") && i + 1 < argc) {
+            min_seconds = std::max(1, atoi(argv[++i])) * 1e-3;
+        } else if (!strcmp(argv[i], "--counters")) {
+            use_counters = true;
+        } else if (!strcmp(argv[i], "--roofline")) {
+            roofline = true;
+        } else if (!strcmp(argv[i], "--frame") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &roof.width, &roof.height) != 2) roof.width = 0;
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            roof.threads = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--scaling")) {
+            scaling = true;
+        } else if (!strcmp(argv[i], "--id-matte")) {
+            id_matte = true;
+        } else if (!strcmp(argv[i], "--palette-sizes") && i + 1 < argc) {
+            id_bench.palette_sizes.clear();
+            for (char* s = argv[++i]; *s;) {
+                int n = (int)strtol(s, &s, 10);
+                if (n > 0 && n <= IdPalette::kMaxColors) id_bench.palette_sizes.push_back(n);
+                if (*s) s++;
+            }
+        } else if (!strcmp(argv[i], "--thread-counts") && i + 1 < argc) {
+            sc.thread_counts.clear();
+            for (char* s = argv[++i]; *s;) {
+                int n = (int)strtol(s, &s, 10);
+                if (n > 0) sc.thread_counts.push_back(n);
+                if (*s) s++;
+            }
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (lengths.empty() || sc.thread_counts.empty() || id_bench.palette_sizes.empty() || roof.width <= 0 ||
+        roof.height <= 0) {
+        usage();
+        return 2;
+    }
+    sc.width = roof.width;
+    sc.height = roof.height;
+    const int cpus = (int)std::max(1u, std::thread::hardware_concurrency());
+    if (std::find(sc.thread_counts.begin(), sc.thread_counts.end(), cpus) == sc.thread_counts.end()) {
+        sc.thread_counts.push_back(cpus);
+    }
+    std::sort(sc.thread_counts.begin(), sc.thread_counts.end());
+
+    std::unique_ptr<PerfCounters> counters;
+    if (use_counters) {
+        counters.reset(new PerfCounters());
+        if (!counters->available()) {
+            fprintf(stderr, "Hardware counters unavailable, timing only: %s\n", counters->error().c_str());
+            counters.reset();
+        }
+    }
+
+    std::vector<Result> results;
+    if (roofline) run_roofline(roof, filter, reps);
+    if (scaling) run_scaling(sc, filter, reps);
+    if (id_matte) run_id_matte(id_bench, reps);
+    for (const Function& f : kFunctions) {
+        if (roofline || scaling || id_matte) break;
+        if (!filter.empty() && !strstr(f.name, filter.c_str())) continue;
+        for (int expansion = 0; expansion < 2; expansion++) {
+            KeyerParams p;
+            if (expansion) set_expansion(p);
+            for (int d = DIST_SCREEN; d <= DIST_EDGES; d++) {
+                for (int length : lengths) {
+                    Input in = make_input((Distribution)d, length, p, 1234u + length);
+                    Result r = run_case(f, p, in, length, reps, min_seconds, counters.get());
+                    r.expansion = expansion != 0;
+                    r.dist = (Distribution)d;
+                    results.push_back(r);
+                    fprintf(stderr, "%-14s %-3s %-10s %6d  %8.3f ns/pixel", f.name,
+                            expansion ? "exp" : "-", kDistributionNames[d], length, r.ns_per_pixel);
+                    if (counters) {
+                        fprintf(stderr, "  IPC %5.2f  br-miss %6.4f  L1D %6.4f  LLC %7.5f /pixel",
+                                ipc(r), per_pixel(r, PERF_BRANCH_MISSES), per_pixel(r, PERF_L1D_MISSES),
+                                per_pixel(r, PERF_LLC_MISSES));
+                    }
+                    fprintf(stderr, "\n");
+                }
+            }
+        }
+    }
+
+    FILE* out = json_path.empty() ? stdout : fopen(json_path.c_str(), "w");
+    if (!out) {
+        perror(json_path.c_str());
+        return 1;
+    }
+    write_json(out, results, reps, min_seconds, roofline ? &roof : nullptr, scaling ? &sc : nullptr,
+               id_matte ? &id_bench : nullptr);
+    if (out != stdout && fclose(out) != 0) {
+        perror(json_path.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,202 @@
+// SimpleColorKeyerServer.cpp - Local key server over POSIX shared memory
+//
+// Keeps one warm keyer process for several local tools. Clients talk to it
+// through ShmKeyerClient (SimpleColorKeyerShm.h); see that header for the
+// protocol. Frames are keyed in place in the shared segment.
+#include "../SimpleColorKeyerShm.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<bool> g_stop(false);
+ShmKeyerLayout g_layout;
+
+void on_signal(int) {
+    g_stop.store(true);
+    // Wake every worker sleeping on the doorbell (futex wake is signal-safe)
+    if (g_layout.header) {
+        g_layout.header->doorbell.fetch_add(1);
+        shm_futex_wake(&g_layout.header->doorbell);
+    }
+}
+
+void key_slot(uint32_t i) {
+    ShmSlot* s = g_layout.slot(i);
+    // The client wrote the size: read it once and check it against the slot
+    // before touching any plane
+    const uint64_t count = (uint64_t)s->width * s->height;
+    const ShmHeader* h = g_layout.header;
+    if (count == 0 || count > (uint64_t)h->max_width * h->max_height) {
+        s->error = EINVAL;
+        return;
+    }
+    s->error = 0;
+    KeyerParams params = s->params.to();
+    const float* r = g_layout.plane(i, 0);
+    const float* g = g_layout.plane(i, 1);
+    const float* b = g_layout.plane(i, 2);
+    float* alpha = g_layout.plane(i, 3);
+    // key_row() counts in int; key in pieces so no slot size can overflow it
+    for (size_t done = 0; done < count;) {
+        const int n = (int)std::min<uint64_t>(count - done, 1u << 24);
+        key_row(params, r + done, g + done, b + done, alpha + done, n);
+        done += n;
+    }
+}
+
+// Return slots claimed by clients that exited without releasing them, and
+// slots their clients abandoned while they were being keyed
+void reap_dead_clients() {
+    ShmHeader* h = g_layout.header;
+    for (uint32_t i = 0; i < h->slot_count; i++) {
+        ShmSlot* s = g_layout.slot(i);
+        uint32_t state = s->state.load(std::memory_order_acquire);
+        if (state == SLOT_DONE && s->owner_pid == kShmSlotAbandoned) {
+            // Keyed after its client gave up waiting
+            s->state.compare_exchange_strong(state, SLOT_FREE);
+        } else if ((state == SLOT_CLAIMED || state == SLOT_DONE) && s->owner_pid > 0 &&
+                   !shm_process_alive(s->owner_pid)) {
+            if (s->state.compare_exchange_strong(state, SLOT_FREE)) {
+                fprintf(stderr, "Reclaimed slot %u from exited client %d\n", i, s->owner_pid);
+            }
+        }
+    }
+}
+
+void worker_loop(int index) {
+    ShmHeader* h = g_layout.header;
+    while (!g_stop.load()) {
+        uint32_t bell = h->doorbell.load(std::memory_order_acquire);
+
+        bool did_work = false;
+        for (uint32_t i = 0; i < h->slot_count; i++) {
+            ShmSlot* s = g_layout.slot(i);
+            uint32_t expected = SLOT_REQUEST;
+            if (s->state.compare_exchange_strong(expected, SLOT_WORKING, std::memory_order_acquire)) {
+                key_slot(i);
+                s->state.store(SLOT_DONE, std::memory_order_release);
+                shm_futex_wake(&s->state);
+                did_work = true;
+            }
+        }
+        if (did_work) continue;
+
+        if (index == 0) reap_dead_clients();
+        // Nothing pending: sleep until the next submit (or a second passes)
+        shm_futex_wait(&h->doorbell, bell, 1000);
+    }
+}
+
+void usage() {
+    fprintf(stderr,
+        "Usage: SimpleColorKeyerServer [--name /shm_name] [--slots n] [--max WxH] [--threads n]\n"
+        "  --name n             Shared memory name (default %s)\n"
+        "  --slots n            Frames in flight across all clients (default 8)\n"
+        "  --max WxH            Largest frame a slot can hold (default 4096x2304)\n"
+        "  --threads n          Keying threads (default: all CPUs)\n",
+        kShmKeyerDefaultName);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* name = kShmKeyerDefaultName;
+    int slots = 8, max_width = 4096, max_height = 2304;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--name") && i + 1 < argc) {
+            name = argv[++i];
+        } else if (!strcmp(argv[i], "--slots") && i + 1 < argc) {
+            slots = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--max") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &max_width, &max_height) != 2) max_width = 0;
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (slots <= 0 || max_width <= 0 || max_height <= 0 || threads <= 0) {
+        usage();
+        return 2;
+    }
+
+    const uint64_t plane_bytes = shm_plane_bytes(max_width, max_height);
+    const uint64_t slot_stride = sizeof(ShmSlot) + 4 * plane_bytes;
+    const uint64_t total = sizeof(ShmHeader) + slots * slot_stride;
+
+    // Never take over a live server's segment: its clients would be orphaned.
+    // A stale segment from a crashed server is replaced.
+    if (pid_t owner = shm_running_server(name)) {
+        if (owner > 0) {
+            fprintf(stderr, "%s is already served by process %d\n", name, (int)owner);
+        } else {
+            fprintf(stderr, "%s is already served by another protocol version\n", name);
+        }
+        return 1;
+    }
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (fd < 0) {
+        perror("shm_open");
+        return 1;
+    }
+    if (ftruncate(fd, (off_t)total) != 0) {
+        perror("ftruncate");
+        shm_unlink(name);
+        return 1;
+    }
+    void* base = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("mmap");
+        shm_unlink(name);
+        return 1;
+    }
+
+    ShmHeader* h = new (base) ShmHeader();
+    h->slot_count = (uint32_t)slots;
+    h->max_width = (uint32_t)max_width;
+    h->max_height = (uint32_t)max_height;
+    h->plane_bytes = plane_bytes;
+    h->slot_stride = slot_stride;
+    h->total_bytes = total;
+    h->doorbell.store(0);
+    h->server_pid = (int32_t)getpid();
+    g_layout.header = h;
+    for (int i = 0; i < slots; i++) {
+        ShmSlot* s = new (g_layout.slot(i)) ShmSlot();
+        s->state.store(SLOT_FREE);
+        s->owner_pid = 0;
+        s->error = 0;
+    }
+    h->version = kShmKeyerVersion;
+    h->server_alive.store(1);
+    std::atomic_thread_fence(std::memory_order_release);
+    h->magic = kShmKeyerMagic;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    fprintf(stderr, "SimpleColorKeyerServer: %s, %d slots of %dx%d, %d threads, %.1f MB\n",
+            name, slots, max_width, max_height, threads, total / (1024.0 * 1024.0));
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) workers.emplace_back(worker_loop, i);
+    for (std::thread& t : workers) t.join();
+
+    // Tell waiting clients we are gone, then remove the name
+    h->server_alive.store(0);
+    for (int i = 0; i < slots; i++) shm_futex_wake(&g_layout.slot(i)->state);
+    shm_unlink(name);
+    munmap(base, total);
+    return 0;
+}
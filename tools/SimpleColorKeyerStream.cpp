@@ -0,0 +1,243 @@
+// SimpleColorKeyerStream.cpp - Key raw frames from stdin to stdout
+//
+// Reads fixed-size raw frames in an ffmpeg pixel format and writes RGBA or
+// alpha-only frames, e.g.
+//
+//   ffmpeg -i plate.mov -f rawvideo -pix_fmt rgb48le - |
+//     SimpleColorKeyerStream -s 1920x1080 -i rgb48le -o rgba64le --key 0.1,0.7,0.2 |
+//     ffmpeg -f rawvideo -pix_fmt rgba64le -s 1920x1080 -i - matte.mov
+//
+// A reader, a keyer and a writer thread pass a small ring of frame buffers
+// between them, so keying overlaps with pipe I/O in both directions.
+//
+// v210 and p210le input is keyed by YCbCrKeyer without decoding to RGB.
+// --check also keys every row of it through the RGB path and reports the
+// largest difference, which should stay within alpha_tolerance().
+#include "KeyerToolArgs.h"
+#include "RawFrameFormats.h"
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Frame {
+    std::vector<uint8_t> in;
+    std::vector<uint8_t> out;
+    std::chrono::steady_clock::time_point read_done;
+    bool eof = false;
+};
+
+// Minimal blocking FIFO used to hand frames between the stages
+class FrameQueue {
+public:
+    void push(Frame* f) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frames_.push_back(f);
+        cond_.notify_one();
+    }
+    Frame* pop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return !frames_.empty(); });
+        Frame* f = frames_.front();
+        frames_.pop_front();
+        return f;
+    }
+private:
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Frame*> frames_;
+};
+
+// Read exactly 'size' bytes; returns false on clean EOF before any byte
+bool read_full(int fd, uint8_t* buf, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, buf + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            if (done > 0) fprintf(stderr, "Truncated frame on input, dropped\n");
+            return false;
+        }
+        done += (size_t)n;
+    }
+    return true;
+}
+
+bool write_full(int fd, const uint8_t* buf, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = write(fd, buf + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += (size_t)n;
+    }
+    return true;
+}
+
+double percentile(std::vector<double> v, double q) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t i = (size_t)(q * (v.size() - 1) + 0.5);
+    return v[i];
+}
+
+void usage() {
+    fprintf(stderr,
+        "Usage: SimpleColorKeyerStream -s WxH [-i in_fmt] [-o out_fmt] [--buffers n] [--check]\n"
+        "                              [keyer options]\n"
+        "  -s WxH               Frame size (required)\n"
+        "  -i fmt               rgb24 | rgb48le | rgba64le | gbrp16le | rgbf32le | gbrpf32le |\n"
+        "                       v210 | p210le (default rgb48le; v210 and p210le are Rec.709\n"
+        "                       video range)\n"
+        "  -o fmt               rgba | rgba64le | rgbaf32le | gray | gray16le | grayf32le\n"
+        "                       (default rgba64le; gray* write alpha only)\n"
+        "  --buffers n          Frames in flight between the stages (default 3, min 2)\n"
+        "  --check              With v210 or p210le input, also key through RGB and report\n"
+        "                       the largest alpha difference (exit status 1 above\n"
+        "                       1e-6 * max(1, gain) * (1 + 1 / tolerance))\n");
+    print_keyer_usage(stderr);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    KeyerParams params;
+    int width = 0, height = 0, buffers = 3;
+    bool check = false;
+    const FormatName* in_fmt = find_format(in_formats, "rgb48le");
+    const FormatName* out_fmt = find_format(out_formats, "rgba64le");
+
+    for (int i = 1; i < argc; i++) {
+        if (parse_keyer_arg(argc, argv, i, params)) continue;
+        if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2) width = 0;
+        } else if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+            in_fmt = find_format(in_formats, argv[++i]);
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            out_fmt = find_format(out_formats, argv[++i]);
+        } else if (!strcmp(argv[i], "--buffers") && i + 1 < argc) {
+            buffers = std::max(2, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--check")) {
+            check = true;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (width <= 0 || height <= 0 || !in_fmt || !out_fmt) {
+        usage();
+        return 2;
+    }
+
+    // Report a closed downstream pipe as a write error instead of dying silently
+    signal(SIGPIPE, SIG_IGN);
+
+    const size_t in_size = input_frame_bytes(*in_fmt, width, height);
+    const size_t out_size = (size_t)width * height * out_fmt->bytes_per_pixel;
+
+    std::vector<Frame> frames(buffers);
+    FrameQueue free_frames, to_key, to_write;
+    for (Frame& f : frames) {
+        f.in.resize(in_size);
+        f.out.resize(out_size);
+        free_frames.push(&f);
+    }
+
+    std::vector<double> latency_ms, key_ms;
+    bool write_failed = false;
+    const bool ycbcr = is_ycbcr(in_fmt->id);
+    const bool rgb_out = out_fmt->id == OUT_RGBA || out_fmt->id == OUT_RGBA64LE || out_fmt->id == OUT_RGBAF32LE;
+    double check_max = 0.0;
+
+    std::thread reader([&] {
+        for (;;) {
+            Frame* f = free_frames.pop();
+            f->eof = !read_full(STDIN_FILENO, f->in.data(), in_size);
+            f->read_done = std::chrono::steady_clock::now();
+            // Once pushed, f belongs to the next stage
+            const bool eof = f->eof;
+            to_key.push(f);
+            if (eof) return;
+        }
+    });
+
+    std::thread keyer([&] {
+        std::vector<float> r(width), g(width), b(width), a(width), rgb_alpha(width);
+        const YCbCrKeyer ycbcr_keys = ycbcr_keyer(params);
+        for (;;) {
+            Frame* f = to_key.pop();
+            if (!f->eof) {
+                auto start = std::chrono::steady_clock::now();
+                for (int y = 0; y < height; y++) {
+                    if (!ycbcr || rgb_out) {
+                        decode_row(in_fmt->id, f->in.data(), width, height, y, r.data(), g.data(), b.data());
+                    }
+                    if (ycbcr) {
+                        key_ycbcr_row(ycbcr_keys, in_fmt->id, f->in.data(), width, height, y, a.data());
+                    } else {
+                        key_row(params, r.data(), g.data(), b.data(), a.data(), width);
+                    }
+                    encode_row(out_fmt->id, f->out.data(), width, y, r.data(), g.data(), b.data(), a.data());
+                }
+                key_ms.push_back(std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count());
+                // Outside the timing: the same rows through decode_row() and key_row()
+                for (int y = 0; check && ycbcr && y < height; y++) {
+                    decode_row(in_fmt->id, f->in.data(), width, height, y, r.data(), g.data(), b.data());
+                    key_row(params, r.data(), g.data(), b.data(), rgb_alpha.data(), width);
+                    key_ycbcr_row(ycbcr_keys, in_fmt->id, f->in.data(), width, height, y, a.data());
+                    for (int x = 0; x < width; x++) {
+                        check_max = std::max(check_max, (double)std::fabs(a[x] - rgb_alpha[x]));
+                    }
+                }
+            }
+            const bool eof = f->eof;
+            to_write.push(f);
+            if (eof) return;
+        }
+    });
+
+    std::thread writer([&] {
+        for (;;) {
+            Frame* f = to_write.pop();
+            if (f->eof) return;
+            if (!write_failed && !write_full(STDOUT_FILENO, f->out.data(), out_size)) {
+                fprintf(stderr, "Write to stdout failed, discarding remaining frames\n");
+                write_failed = true;
+            }
+            latency_ms.push_back(std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - f->read_done).count());
+            free_frames.push(f);
+        }
+    });
+
+    reader.join();
+    keyer.join();
+    writer.join();
+
+    // Latency is measured from a frame being fully read to it being fully written
+    fprintf(stderr, "SimpleColorKeyerStream: %zu frames %dx%d %s -> %s\n",
+            latency_ms.size(), width, height, in_fmt->name, out_fmt->name);
+    fprintf(stderr, "  latency ms  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+            percentile(latency_ms, 0.5), percentile(latency_ms, 0.9),
+            percentile(latency_ms, 0.99), percentile(latency_ms, 1.0));
+    fprintf(stderr, "  key ms      p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+            percentile(key_ms, 0.5), percentile(key_ms, 0.9),
+            percentile(key_ms, 0.99), percentile(key_ms, 1.0));
+    if (check && ycbcr) {
+        const float bound = ycbcr_keyer(params).alpha_tolerance();
+        const bool within = check_max <= bound;
+        fprintf(stderr, "  check       max |alpha - key_row alpha| %.3g (%s %.3g)\n", check_max,
+                within ? "within" : "ABOVE", bound);
+        if (!within) return 1;
+    }
+    return write_failed ? 1 : 0;
+}
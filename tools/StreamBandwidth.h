@@ -0,0 +1,88 @@
+// StreamBandwidth.h - STREAM-style sustainable memory bandwidth
+//
+// Measures the copy (a = b) and triad (a = b + s * c) kernels of McCalpin's
+// STREAM benchmark over arrays much larger than the last-level cache, on
+// all requested threads. Work is split statically and each thread first
+// touches the part it later streams, so on NUMA hosts pages are placed on
+// the node that reads them. Bytes are counted the STREAM way: 2 arrays per
+// element for copy and 3 for triad, ignoring write-allocate traffic.
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+// Run fn(begin, end) over [0, n) split evenly across 'threads' threads; the
+// same n and thread count always give each thread the same range
+template <typename F>
+void run_partitioned(int threads, size_t n, const F& fn) {
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) {
+        pool.emplace_back([&, t] { fn(n * t / threads, n * (t + 1) / threads); });
+    }
+    fn(0, n / threads);
+    for (std::thread& th : pool) th.join();
+}
+
+// Last-level cache size in bytes, 0 if unknown
+inline size_t last_level_cache_bytes() {
+#if defined(__linux__) && defined(_SC_LEVEL3_CACHE_SIZE)
+    long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (l3 > 0) return (size_t)l3;
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (l2 > 0) return (size_t)l2;
+#endif
+    return 0;
+}
+
+struct StreamResult {
+    double copy_gbs = 0.0;          // best of the repetitions, 1e9 bytes/s
+    double triad_gbs = 0.0;
+    size_t array_bytes = 0;
+};
+
+inline StreamResult measure_stream(size_t array_bytes, int threads, int reps) {
+    const size_t n = array_bytes / sizeof(double);
+    // new double[] leaves the pages untouched; write them from their owners
+    std::unique_ptr<double[]> a(new double[n]), b(new double[n]), c(new double[n]);
+    double* pa = a.get();
+    double* pb = b.get();
+    double* pc = c.get();
+    run_partitioned(threads, n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            pa[i] = 0.0;
+            pb[i] = 1.0;
+            pc[i] = 2.0;
+        }
+    });
+
+    StreamResult r;
+    r.array_bytes = n * sizeof(double);
+    const double scalar = 3.0;
+    for (int rep = 0; rep < reps; rep++) {
+        auto t0 = std::chrono::steady_clock::now();
+        run_partitioned(threads, n, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) pa[i] = pb[i];
+        });
+        auto t1 = std::chrono::steady_clock::now();
+        run_partitioned(threads, n, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) pa[i] = pb[i] + scalar * pc[i];
+        });
+        auto t2 = std::chrono::steady_clock::now();
+        double copy = std::chrono::duration<double>(t1 - t0).count();
+        double triad = std::chrono::duration<double>(t2 - t1).count();
+        r.copy_gbs = std::max(r.copy_gbs, 2.0 * r.array_bytes / copy * 1e-9);
+        r.triad_gbs = std::max(r.triad_gbs, 3.0 * r.array_bytes / triad * 1e-9);
+    }
+    // Keep the stores observable
+    volatile double sink = pa[n / 2];
+    (void)sink;
+    return r;
+}
@@ -0,0 +1,77 @@
+#!/bin/sh
+# build_pgo.sh - Two-stage profile-guided build of SimpleColorKeyer.so
+#
+#   tools/pgo/build_pgo.sh [NUKE_VERSION] [plate ...]
+#
+# 1. builds a plain -O3 plugin and times every keying method with
+#    train_keyer.py under Nuke in terminal mode
+# 2. builds an instrumented plugin (KEYER_PGO=GENERATE) and runs the same
+#    workload to collect profiles
+# 3. rebuilds from the profiles with LTO and hidden visibility
+#    (KEYER_PGO=USE) and prints the speedup per method
+#
+# The standalone tools go through the same stages; their kernels are
+# trained with SimpleColorKeyerMicroBench and compared with
+# SimpleColorKeyerBenchCompare. Set NUKE to the Nuke executable if it is
+# not NDKDIR/NukeX.Y, and KEYER_PGO_SIZE / KEYER_PGO_FRAMES to change the
+# workload.
+set -e
+
+NUKE_VERSION=${1:-16.0v6}
+[ $# -gt 0 ] && shift
+NDKDIR=/opt/Nuke${NUKE_VERSION}
+NUKE=${NUKE:-$NDKDIR/Nuke${NUKE_VERSION%v*}}
+SIZE=${KEYER_PGO_SIZE:-3840x2160}
+FRAMES=${KEYER_PGO_FRAMES:-10}
+
+SRC=$(cd "$(dirname "$0")/../.." && pwd)
+OUT=$SRC/build-pgo
+PROFILES=$OUT/profiles
+JOBS=$(nproc 2>/dev/null || echo 4)
+
+# configure BUILD_DIR PGO_STAGE
+configure() {
+    cmake -S "$SRC" -B "$1" -DNUKE_VERSION="$NUKE_VERSION" -DCMAKE_BUILD_TYPE=Release \
+          -DBUILD_KEYER_TOOLS=ON -DKEYER_PGO="$2" -DKEYER_PGO_DIR="$PROFILES" >/dev/null
+    cmake --build "$1" -j"$JOBS" >/dev/null
+}
+
+# workload BUILD_DIR [train_keyer.py options]
+workload() {
+    dir=$1
+    shift
+    "$NUKE" -t "$SRC/tools/pgo/train_keyer.py" --plugin-dir "$dir" --size "$SIZE" \
+            --frames "$FRAMES" "$@"
+}
+
+if [ ! -f "$SRC/CMakeLists.txt" ]; then
+    echo "Copy CMakeLists_LINUX.txt to CMakeLists.txt first" >&2
+    exit 1
+fi
+
+rm -rf "$OUT"
+mkdir -p "$OUT"
+
+echo "== Baseline build"
+configure "$OUT/baseline" OFF
+workload "$OUT/baseline" --json "$OUT/baseline.json" -- "$@"
+"$OUT/baseline/SimpleColorKeyerMicroBench" --reps 15 --json "$OUT/baseline-micro.json" 2>/dev/null
+
+echo "== Instrumented build and training run"
+configure "$OUT/pgo" GENERATE
+workload "$OUT/pgo" --reps 1 -- "$@"
+"$OUT/pgo/SimpleColorKeyerMicroBench" --reps 1 --min-time 5 >/dev/null 2>&1
+if ls "$PROFILES"/*.profraw >/dev/null 2>&1; then
+    llvm-profdata merge -output="$PROFILES/default.profdata" "$PROFILES"/*.profraw
+fi
+
+echo "== Optimized build (profile-use, LTO, hidden visibility)"
+configure "$OUT/pgo" USE
+workload "$OUT/pgo" --json "$OUT/pgo.json" --compare "$OUT/baseline.json" -- "$@"
+"$OUT/pgo/SimpleColorKeyerMicroBench" --reps 15 --json "$OUT/pgo-micro.json" 2>/dev/null
+echo
+echo "== Core kernels (SimpleColorKeyerMicroBench)"
+"$OUT/pgo/SimpleColorKeyerBenchCompare" "$OUT/baseline-micro.json" "$OUT/pgo-micro.json" --all || true
+
+echo
+echo "Optimized plugin: $OUT/pgo/SimpleColorKeyer.so"
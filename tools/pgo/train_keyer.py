@@ -0,0 +1,102 @@
+# train_keyer.py - Headless SimpleColorKeyer workload for PGO training and timing
+#
+# Run with Nuke in terminal mode:
+#
+#   Nuke16.0 -t tools/pgo/train_keyer.py --plugin-dir build [--json times.json]
+#            [--compare baseline.json] [--size 3840x2160] [--frames 10] [plate ...]
+#
+# Renders every keying method, with the color-range knobs off and on, over
+# the given plates (any format Nuke reads) or, without plates, a synthetic
+# green screen with a soft foreground and noisy edges. The time of a plate
+# render without the keyer is subtracted, so the reported ms/frame is the
+# keyer's own cost. With --compare, prints the speedup per method against
+# an earlier --json result.
+import argparse
+import json
+import os
+import tempfile
+import time
+
+import nuke
+
+METHODS = ["distance", "chroma", "luma_weighted", "adaptive"]
+
+EXPANSION = {"red_range": 0.3, "magenta_range": -0.2, "green_range": 0.5,
+             "yellow_range": -0.1, "blue_range": 0.2, "cyan_range": -0.4}
+
+
+def synthetic_plate(width, height):
+    fmt = nuke.addFormat("%d %d 1 keyer_pgo" % (width, height))
+    screen = nuke.nodes.Constant(color=(0.1, 0.7, 0.2, 1.0), format=fmt.name())
+    grain = nuke.nodes.Noise(inputs=[screen], size=3)
+    grain["opacity"].setValue(0.15)
+    fg = nuke.nodes.Radial(inputs=[grain], area=(width * 0.3, height * 0.2, width * 0.7, height * 0.9),
+                           softness=0.4, color=(0.8, 0.5, 0.4, 1.0))
+    return fg
+
+
+def render(node, frames, out_dir):
+    write = nuke.nodes.Write(inputs=[node], channels="alpha", file_type="exr",
+                             file=os.path.join(out_dir, "pgo.####.exr"))
+    write["datatype"].setValue("16 bit half")
+    write["compression"].setValue("none")
+    if hasattr(nuke, "clearRAMCache"):
+        nuke.clearRAMCache()
+    start = time.time()
+    nuke.execute(write, 1, frames)
+    elapsed = time.time() - start
+    nuke.delete(write)
+    return elapsed * 1000.0 / frames
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--plugin-dir", required=True)
+    parser.add_argument("--size", default="3840x2160")
+    parser.add_argument("--frames", type=int, default=10)
+    parser.add_argument("--reps", type=int, default=3)
+    parser.add_argument("--json")
+    parser.add_argument("--compare")
+    parser.add_argument("plates", nargs="*")
+    args = parser.parse_args()
+
+    nuke.pluginAddPath(os.path.abspath(args.plugin_dir))
+    nuke.load("SimpleColorKeyer")
+    width, height = (int(v) for v in args.size.split("x"))
+
+    plates = [nuke.nodes.Read(file=p) for p in args.plates] or [synthetic_plate(width, height)]
+    out_dir = tempfile.mkdtemp(prefix="keyer_pgo_")
+    results = {}
+    for plate in plates:
+        # The plate's own alpha: the cost of everything but the keyer
+        base = min(render(plate, args.frames, out_dir) for _ in range(args.reps))
+
+        for index, method in enumerate(METHODS):
+            for expansion in (False, True):
+                keyer = nuke.nodes.SimpleColorKeyer(inputs=[plate])
+                keyer["key_color"].setValue((0.1, 0.7, 0.2))
+                keyer["method"].setValue(index)
+                if expansion:
+                    for knob, value in EXPANSION.items():
+                        keyer[knob].setValue(value)
+                best = min(render(keyer, args.frames, out_dir) for _ in range(args.reps))
+                nuke.delete(keyer)
+                name = method + ("+exp" if expansion else "")
+                results[name] = results.get(name, 0.0) + max(0.0, best - base)
+                print("%-20s %8.2f ms/frame" % (name, best - base))
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump({"size": args.size, "frames": args.frames, "ms_per_frame": results}, f, indent=2)
+
+    if args.compare:
+        with open(args.compare) as f:
+            before = json.load(f)["ms_per_frame"]
+        print("\n%-20s %10s %10s %8s" % ("method", "before", "after", "speedup"))
+        for name in sorted(results):
+            if name in before and results[name] > 0.0:
+                print("%-20s %10.2f %10.2f %7.2fx" % (name, before[name], results[name],
+                                                     before[name] / results[name]))
+
+
+main()
@@ -0,0 +1,38 @@
+# setup.py - Build the simplecolorkeyer Python module
+#
+#   pip install tools/python            (or: python setup.py build_ext --inplace)
+#
+# Alpha is bit-identical to the node when both are built with the same
+# compiler and floating-point flags: -O3 and GNU C++17, as in the CMake
+# files, so multiply-adds are contracted the same way in both.
+import os
+import sys
+
+from setuptools import Extension, setup
+
+here = os.path.dirname(os.path.abspath(__file__))
+tools = os.path.dirname(here)
+
+if sys.platform == "win32":
+    compile_args = ["/std:c++17", "/O2"]
+    link_args = []
+else:
+    compile_args = ["-std=gnu++17", "-O3", "-fvisibility=hidden"]
+    link_args = ["-pthread"]
+
+setup(
+    name="simplecolorkeyer",
+    version="2.0",
+    description="SimpleColorKeyer keying core for NumPy and other buffer-protocol arrays",
+    ext_modules=[
+        Extension(
+            "simplecolorkeyer",
+            sources=[os.path.join(here, "simplecolorkeyer.cpp"),
+                     os.path.join(tools, "SimpleColorKeyerC.cpp")],
+            define_macros=[("SCK_C_BUILD", None)],
+            extra_compile_args=compile_args,
+            extra_link_args=link_args,
+            language="c++",
+        )
+    ],
+)
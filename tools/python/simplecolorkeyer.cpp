@@ -0,0 +1,237 @@
+// simplecolorkeyer.cpp - Python module over the C ABI (SimpleColorKeyerC.h)
+//
+//   import numpy as np, simplecolorkeyer as sck
+//   alpha = np.asarray(sck.key(rgb, key=(0.1, 0.7, 0.2), tolerance=0.25, method="chroma"))
+//
+// 'image' is any object exporting the buffer protocol (NumPy arrays,
+// memoryviews, ...) with float32 ('f') or float16 ('e') samples:
+//
+//   - interleaved, shape (height, width, channels), channels >= 3
+//   - planar, shape (channels, height, width), channels >= 3
+//   - a tuple of three 2D (height, width) buffers for R, G and B
+//
+// Any strides are accepted, so slices and transposed views are keyed in
+// place without a copy; the first three channels are R, G and B. The
+// layout of a 3D buffer is taken from its shape (a last axis of 3 or 4 means
+// interleaved) unless planar=True/False says otherwise. Alpha is written to
+// 'out' (a writable 2D float32 buffer, any strides) or to a new float32
+// buffer returned as a (height, width) memoryview (an empty 1D one for an
+// empty image). The GIL is released while
+// keying, which runs on all CPUs unless 'threads' is given.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "../../SimpleColorKeyerC.h"
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+// Buffers held for the duration of one call
+struct Buffers {
+    Py_buffer views[4];
+    int count = 0;
+
+    ~Buffers() {
+        for (int i = 0; i < count; i++) PyBuffer_Release(&views[i]);
+    }
+
+    Py_buffer* get(PyObject* obj, int flags) {
+        if (PyObject_GetBuffer(obj, &views[count], flags) != 0) return nullptr;
+        return &views[count++];
+    }
+};
+
+// Sample type from a struct-module format string, or -1
+int sample_type(const Py_buffer* view) {
+    const char* f = view->format ? view->format : "B";
+    if (*f == '<' || *f == '=' || *f == '@') f++;
+    if (!strcmp(f, "f") && view->itemsize == 4) return SCK_FLOAT32;
+    if (!strcmp(f, "e") && view->itemsize == 2) return SCK_FLOAT16;
+    return -1;
+}
+
+bool parse_method(PyObject* obj, int& method) {
+    if (PyLong_Check(obj)) {
+        method = (int)PyLong_AsLong(obj);
+    } else if (PyUnicode_Check(obj)) {
+        const char* m = PyUnicode_AsUTF8(obj);
+        if (!m) return false;
+        method = !strcmp(m, "distance") ? 0 : !strcmp(m, "chroma") ? 1
+               : !strcmp(m, "luma") || !strcmp(m, "luma_weighted") ? 2 : !strcmp(m, "adaptive") ? 3 : -1;
+    } else {
+        method = -1;
+    }
+    if (method < 0 || method > 3) {
+        PyErr_SetString(PyExc_ValueError, "method must be 'distance', 'chroma', 'luma', 'adaptive' or 0-3");
+        return false;
+    }
+    return true;
+}
+
+PyObject* key(PyObject*, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = { "image", "key", "tolerance", "method", "gain", "invert",
+                                      "red", "green", "blue", "yellow", "magenta", "cyan",
+                                      "planar", "out", "threads", nullptr };
+    sck_params params;
+    sck_default_params(&params);
+    PyObject* image = nullptr;
+    PyObject* method = nullptr;
+    PyObject* planar = Py_None;
+    PyObject* out = Py_None;
+    int invert = 0, threads = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|$(fff)fOfpffffffOOi", const_cast<char**>(keywords),
+                                     &image, &params.key_color[0], &params.key_color[1],
+                                     &params.key_color[2], &params.tolerance, &method, &params.gain,
+                                     &invert, &params.red, &params.green, &params.blue, &params.yellow,
+                                     &params.magenta, &params.cyan, &planar, &out, &threads)) {
+        return nullptr;
+    }
+    params.invert = invert;
+    if (method && !parse_method(method, params.method)) return nullptr;
+
+    Buffers buffers;
+    sck_plane rgb[3];
+    Py_ssize_t height = 0, width = 0;
+    int type = -1;
+    if (PyTuple_Check(image) || PyList_Check(image)) {
+        if (PySequence_Size(image) != 3) {
+            PyErr_SetString(PyExc_ValueError, "expected three planes (r, g, b)");
+            return nullptr;
+        }
+        for (int c = 0; c < 3; c++) {
+            PyObject* item = PySequence_GetItem(image, c);
+            if (!item) return nullptr;
+            Py_buffer* v = buffers.get(item, PyBUF_RECORDS_RO);
+            Py_DECREF(item);
+            if (!v) return nullptr;
+            if (v->ndim != 2 || (c && (v->shape[0] != height || v->shape[1] != width ||
+                                       sample_type(v) != type))) {
+                PyErr_SetString(PyExc_ValueError, "planes must be 2D and of the same shape and type");
+                return nullptr;
+            }
+            height = v->shape[0];
+            width = v->shape[1];
+            type = sample_type(v);
+            rgb[c].data = v->buf;
+            rgb[c].x_stride = v->strides[1];
+            rgb[c].y_stride = v->strides[0];
+        }
+    } else {
+        Py_buffer* v = buffers.get(image, PyBUF_RECORDS_RO);
+        if (!v) return nullptr;
+        if (v->ndim != 3) {
+            PyErr_SetString(PyExc_ValueError, "image must be 3D (height, width, channels) or (channels, height, width)");
+            return nullptr;
+        }
+        type = sample_type(v);
+        bool is_planar = planar == Py_None ? !(v->shape[2] == 3 || v->shape[2] == 4) : PyObject_IsTrue(planar) == 1;
+        const int ch = is_planar ? 0 : 2, yx[2] = { is_planar ? 1 : 0, is_planar ? 2 : 1 };
+        if (v->shape[ch] < 3) {
+            PyErr_SetString(PyExc_ValueError, "image needs at least three channels");
+            return nullptr;
+        }
+        height = v->shape[yx[0]];
+        width = v->shape[yx[1]];
+        for (int c = 0; c < 3; c++) {
+            rgb[c].data = static_cast<const char*>(v->buf) + c * v->strides[ch];
+            rgb[c].x_stride = v->strides[yx[1]];
+            rgb[c].y_stride = v->strides[yx[0]];
+        }
+    }
+    if (type < 0) {
+        PyErr_SetString(PyExc_TypeError, "image samples must be float32 or float16");
+        return nullptr;
+    }
+    if (height > INT32_MAX || width > INT32_MAX) {
+        PyErr_SetString(PyExc_ValueError, "image too large");
+        return nullptr;
+    }
+
+    // Output: the caller's buffer, or a new bytearray viewed as (height, width) float32
+    PyObject* result = nullptr;
+    float* alpha;
+    Py_ssize_t ax, ay;
+    if (out != Py_None) {
+        Py_buffer* o = buffers.get(out, PyBUF_RECORDS);
+        if (!o) return nullptr;
+        if (o->ndim != 2 || o->shape[0] != height || o->shape[1] != width || sample_type(o) != SCK_FLOAT32) {
+            PyErr_SetString(PyExc_ValueError, "out must be a writable float32 buffer of shape (height, width)");
+            return nullptr;
+        }
+        alpha = static_cast<float*>(o->buf);
+        ax = o->strides[1];
+        ay = o->strides[0];
+        Py_INCREF(out);
+        result = out;
+    } else {
+        PyObject* bytes = PyByteArray_FromStringAndSize(nullptr, height * width * (Py_ssize_t)sizeof(float));
+        if (!bytes) return nullptr;
+        alpha = reinterpret_cast<float*>(PyByteArray_AS_STRING(bytes));
+        PyObject* view = PyMemoryView_FromObject(bytes);
+        Py_DECREF(bytes);
+        if (!view) return nullptr;
+        // The cast view keeps the bytearray alive (and unresizable). A
+        // memoryview cannot take a shape with a zero in it, so an empty
+        // image gets an empty one-dimensional buffer.
+        if (height == 0 || width == 0) {
+            result = PyObject_CallMethod(view, "cast", "s", "f");
+        } else {
+            result = PyObject_CallMethod(view, "cast", "s(nn)", "f", height, width);
+        }
+        Py_DECREF(view);
+        if (!result) return nullptr;
+        ax = sizeof(float);
+        ay = width * (Py_ssize_t)sizeof(float);
+    }
+
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    status = sck_key_image(&params, (sck_type)type, rgb, (int)width, (int)height, alpha, ax, ay, threads);
+    Py_END_ALLOW_THREADS
+    if (status != SCK_OK) {
+        Py_DECREF(result);
+        PyErr_SetString(PyExc_ValueError, sck_status_string(status));
+        return nullptr;
+    }
+    return result;
+}
+
+PyObject* key_pixel(PyObject*, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = { "r", "g", "b", "key", "tolerance", "method", "gain", "invert",
+                                      "red", "green", "blue", "yellow", "magenta", "cyan", nullptr };
+    sck_params params;
+    sck_default_params(&params);
+    float r, g, b;
+    PyObject* method = nullptr;
+    int invert = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "fff|$(fff)fOfpffffff", const_cast<char**>(keywords),
+                                     &r, &g, &b, &params.key_color[0], &params.key_color[1],
+                                     &params.key_color[2], &params.tolerance, &method, &params.gain,
+                                     &invert, &params.red, &params.green, &params.blue, &params.yellow,
+                                     &params.magenta, &params.cyan)) {
+        return nullptr;
+    }
+    params.invert = invert;
+    if (method && !parse_method(method, params.method)) return nullptr;
+    return PyFloat_FromDouble(sck_key_pixel(&params, r, g, b));
+}
+
+PyMethodDef methods[] = {
+    { "key", (PyCFunction)(void (*)(void))key, METH_VARARGS | METH_KEYWORDS,
+      "key(image, *, key=(0, 1, 0), tolerance=0.3, method='distance', gain=1.0, invert=False,\n"
+      "    red=0, green=0, blue=0, yellow=0, magenta=0, cyan=0, planar=None, out=None, threads=0)\n\n"
+      "Key a float32/float16 image and return its alpha as a (height, width) float32 buffer." },
+    { "key_pixel", (PyCFunction)(void (*)(void))key_pixel, METH_VARARGS | METH_KEYWORDS,
+      "key_pixel(r, g, b, **knobs) -> float\n\nAlpha of a single pixel, with the same knobs as key()." },
+    { nullptr, nullptr, 0, nullptr }
+};
+
+PyModuleDef module = {
+    PyModuleDef_HEAD_INIT, "simplecolorkeyer",
+    "SimpleColorKeyer keying core: alpha bit-identical to the Nuke node.", -1, methods,
+    nullptr, nullptr, nullptr, nullptr
+};
+
+} // namespace
+
+PyMODINIT_FUNC PyInit_simplecolorkeyer(void) { return PyModule_Create(&module); }